@@ -0,0 +1,30 @@
+// ----------------------------------------------------------------------------
+// ButtonScanner
+// Debounces up to 16 inputs in parallel from the 1 ms timer interrupt.
+//
+// Every BUTTON_SCANNER_INTERVAL milliseconds ButtonScannerService() reads
+// each input register that holds one of the inputs once and debounces all
+// inputs at the same time with a vertical counter: bit i of two 16 bit
+// words form a 2 bit counter for input i, so an input has to read the same
+// for four samples in a row before its debounced state changes. Press and
+// release edges are collected in bitmasks until the main loop takes them.
+//
+// All inputs close to GND, bit i belongs to pins[i] of ButtonScannerInit().
+// ----------------------------------------------------------------------------
+
+#ifndef BUTTONSCANNER_H
+#define BUTTONSCANNER_H
+
+#include <Arduino.h>
+
+#define BUTTON_SCANNER_MAX_INPUTS   16      // one bit per input in the 16 bit masks
+#define BUTTON_SCANNER_MAX_PORTS    8       // number of different input registers the inputs may use
+#define BUTTON_SCANNER_INTERVAL     5       // milliseconds between two samples, four equal samples debounce an input
+
+void ButtonScannerInit( const uint8_t *pins, uint8_t count );
+void ButtonScannerService();
+uint16_t ButtonScannerTakePressed();
+uint16_t ButtonScannerTakeReleased();
+uint16_t ButtonScannerGetState();
+
+#endif // BUTTONSCANNER_H
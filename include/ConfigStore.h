@@ -0,0 +1,64 @@
+// ----------------------------------------------------------------------------
+// ConfigStore
+// Everything the controller keeps over a power cycle, cached in RAM.
+//
+// CONFIG has the same layout as the EEPROM, from address 0 on.
+// ConfigStoreLoad() reads it in one piece at boot. From then on every
+// value is read from RAM, e.g. the position of a button is a plain array
+// lookup. The EEPROM is never read again.
+//
+// After a value has been changed in CONFIG, CONFIG_STORE_SAVE() marks the
+// field dirty. The field is queued in the EepromWriter, which writes it
+// back in the background and skips every byte whose stored value is
+// unchanged. A field that is changed again before it has been written is
+// only queued once.
+//
+// New values go to the end of the struct, so the addresses of the older
+// values stay the same. An EEPROM cell that has never been written reads
+// 0xFF, so the caller checks new values against their range after loading.
+// The struct may grow up to address 128, older versions kept the
+// PositionJournal there.
+// ----------------------------------------------------------------------------
+
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include <Arduino.h>
+
+#define CONFIG_STORE_POSITIONS  12      // number of position buttons
+#define CONFIG_STORE_ENDSTOPS   2       // number of endstops
+
+// the drift statistics of an endstop, see DriftMonitor
+struct ConfigStoreDrift
+{
+    unsigned int count;                             // the number of measured trips
+    long last;                                      // the drift of the last trip in steps
+    long min;                                       // the smallest drift in steps
+    long max;                                       // the largest drift in steps
+    unsigned long sumAbs;                           // the sum of the absolute drifts in steps
+} __attribute__((packed));
+
+struct ConfigStoreData
+{
+    unsigned long trackSteps;                       // the number of steps from one endstop to the other
+    unsigned long positions[CONFIG_STORE_POSITIONS]; // the stored position of every button in steps
+    unsigned int minSpeedRpm;                       // minimum motor speed in rounds per minute
+    unsigned int maxSpeedRpm;                       // maximum motor speed in rounds per minute
+    unsigned int calibrationSpeedRpm;               // the speed of the calibration and the homing in rounds per minute
+    unsigned int accelSteps;                        // the number of steps for the acceleration phase in a move
+    unsigned int motorPpr;                          // pulses per revolution of the motor
+    byte motorProfile;                              // the acceleration profile: RAMP_PROFILE_LINEAR or RAMP_PROFILE_SCURVE
+    unsigned int softLimitSteps;                    // drive mode stops this many steps before each endstop
+    byte uiLanguage;                                // the language of the display: UI_TEXT_GERMAN or UI_TEXT_ENGLISH
+    ConfigStoreDrift drift[CONFIG_STORE_ENDSTOPS];  // the drift statistics of endstop A and endstop B
+} __attribute__((packed));
+
+extern ConfigStoreData CONFIG;
+
+// queues a field of CONFIG to be written back, e.g. CONFIG_STORE_SAVE(positions[3])
+#define CONFIG_STORE_SAVE(field) ConfigStoreSave( &CONFIG.field, sizeof(CONFIG.field) )
+
+void ConfigStoreLoad();
+void ConfigStoreSave( const void *field, byte length );
+
+#endif // CONFIGSTORE_H
@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------------
+// DisplayBuffer
+// Draws into RAM and sends only the changed parts to the PCD8544.
+//
+// Adafruit_PCD8544::display() always transfers the whole 504 byte frame
+// over the software SPI, and DisplayMessage() called it after every string,
+// so a screen with ten strings moved about 5 KB to the LCD. DisplayBuffer
+// is an Adafruit_GFX of its own that draws into the frame buffer of the
+// library, pcd8544_buffer, which has the memory layout of the LCD: 6 banks
+// of 8 pixel rows, one byte per column and bank. A second buffer would
+// cost another 504 bytes of the 8 KB SRAM. Drawing only changes the buffer
+// and widens the dirty column range of the bank if a byte really changes,
+// redrawing the same text marks nothing. flush() is called once per loop
+// and sends the dirty column range of each bank.
+//
+// Sending a whole frame over the software SPI takes several milliseconds,
+// too long for a loop that has to feed the move queue and the serial port.
+// With a time budget flush() stops as soon as the budget is used up and
+// continues with the next slice in the next loop. The dirty range of the
+// bank simply starts behind the last byte sent, so anything drawn in the
+// meantime is picked up as well. The step pulses come from a timer
+// interrupt and are never delayed by the transfer. The longest slice is
+// measured, the budget is checked before every byte so a slice may take
+// one byte longer than the budget.
+//
+// The Adafruit_PCD8544 object is only used to initialise the LCD and as
+// the transport for the commands and data bytes. Do not draw on it or call
+// its display(), that bypasses the dirty ranges.
+// ----------------------------------------------------------------------------
+
+#ifndef DISPLAYBUFFER_H
+#define DISPLAYBUFFER_H
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_PCD8544.h>
+
+#define DISPLAY_BUFFER_WIDTH    84      // pixel columns of the LCD
+#define DISPLAY_BUFFER_HEIGHT   48      // pixel rows of the LCD
+#define DISPLAY_BUFFER_BANKS    (DISPLAY_BUFFER_HEIGHT / 8) // the LCD addresses 8 pixel rows at once
+
+class DisplayBuffer : public Adafruit_GFX
+{
+    public:
+        DisplayBuffer( Adafruit_PCD8544 &lcd );
+
+        void drawPixel( int16_t x, int16_t y, uint16_t color ) override;
+        void fillScreen( uint16_t color ) override;
+        void clearDisplay();
+
+        void invalidate();
+        bool isDirty();
+        unsigned int flush( unsigned long budget = 0 );
+        unsigned long getWorstSlice();
+
+    private:
+        Adafruit_PCD8544 &lcd;
+        uint8_t *buffer;                            // the pixels bank after bank, the frame buffer of the library
+        uint8_t dirtyFirst[DISPLAY_BUFFER_BANKS];   // first changed column per bank, DISPLAY_BUFFER_WIDTH = clean
+        uint8_t dirtyLast[DISPLAY_BUFFER_BANKS];    // last changed column per bank
+        uint8_t flushBank;                          // the bank the next slice starts with
+        unsigned long worstSlice;                   // the longest flush() with a budget in microseconds
+
+        void markDirty( uint8_t bank, uint8_t firstColumn, uint8_t lastColumn );
+};
+
+#endif // DISPLAYBUFFER_H
@@ -0,0 +1,34 @@
+// ----------------------------------------------------------------------------
+// DriftMonitor
+// Statistics of how far from the counted position the endstops trip.
+//
+// The position is only set at endstop A, from then on the StepEngine
+// counts the steps. A step lost to a stall or a slipping coupling is not
+// seen until the next homing, and the lift stops a little off at every
+// stored position. Whenever an endstop trips while the counted position
+// is still valid, the caller passes the difference between the position
+// latched by the StepEngine and the expected one, 0 for endstop A and the
+// track length for endstop B.
+//
+// Per endstop the number of trips, the last, the smallest and the largest
+// difference and the sum of the absolute differences are kept in CONFIG,
+// so they survive a power cycle and are written back by the EepromWriter.
+// A positive difference means the endstop tripped before the counted
+// position reached it.
+// ----------------------------------------------------------------------------
+
+#ifndef DRIFTMONITOR_H
+#define DRIFTMONITOR_H
+
+#include <Arduino.h>
+
+#define DRIFT_MONITOR_ENDSTOP_A     0       // index of the statistics of endstop A
+#define DRIFT_MONITOR_ENDSTOP_B     1       // index of the statistics of endstop B
+#define DRIFT_MONITOR_WARNING       20      // a difference of more steps is logged as a warning
+
+void DriftMonitorInit();
+void DriftMonitorRecord( byte endStop, long drift );
+void DriftMonitorReset();
+unsigned long DriftMonitorGetMeanAbs( byte endStop );
+
+#endif // DRIFTMONITOR_H
@@ -0,0 +1,24 @@
+// ----------------------------------------------------------------------------
+// EepromWriter
+// Writes values to the EEPROM in the background.
+//
+// Writing one EEPROM byte takes 3.3 ms and EEPROM.put() waits for every byte,
+// so saving the motor settings blocked the main loop for almost 40 ms.
+// EepromWriterSchedule() only queues the address and the RAM location of a
+// value, EepromWriterTask() is called once per loop and writes a single byte
+// whenever the EEPROM is ready for it. The bytes are read from RAM when they
+// are written, so the scheduled value must stay in place (globals do).
+// Unchanged bytes are skipped to save EEPROM write cycles.
+// ----------------------------------------------------------------------------
+
+#ifndef EEPROMWRITER_H
+#define EEPROMWRITER_H
+
+#include <Arduino.h>
+
+#define EEPROM_WRITER_QUEUE_SIZE    16  // number of values that can wait to be written
+
+void EepromWriterSchedule( int address, const void *source, byte length );
+void EepromWriterTask();
+
+#endif // EEPROMWRITER_H
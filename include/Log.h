@@ -0,0 +1,70 @@
+// ----------------------------------------------------------------------------
+// Log
+// Buffered diagnostic output with compile time levels.
+//
+// Serial.print() blocks as soon as the TX buffer of the UART is full and then
+// waits for every further character to be sent, long enough to stall a move
+// that waits for the main loop. The LOG_* macros format the message into a
+// RAM ring buffer instead, LogTask() is called once per loop and only hands
+// the UART as many bytes as fit into its TX buffer without waiting. It always
+// leaves LOG_UART_RESERVE bytes free, so a reply of the SerialProtocol that
+// shares the port is never held up by log text.
+//
+// The format strings stay in flash (PSTR) and use the printf syntax,
+// e.g. %u for unsigned int and %lu for unsigned long. Messages above
+// LOG_LEVEL compile to nothing, their arguments are not even evaluated.
+// A message that does not fit into the buffer is dropped and counted,
+// LogTask() reports the number of dropped messages once there is room again.
+//
+// Do not log from interrupts, the buffer is only written by the main loop.
+// ----------------------------------------------------------------------------
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+// the highest level that is compiled in, override with -D LOG_LEVEL=4 in build_flags
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           LOG_LEVEL_INFO
+#endif
+
+#define LOG_BUFFER_SIZE     256     // bytes of log text waiting for the UART
+#define LOG_LINE_SIZE       64      // longest message in bytes, longer messages are cut
+#define LOG_UART_RESERVE    48      // bytes of the UART TX buffer left free for the frames of the SerialProtocol
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...)  LogWrite( 'E', PSTR(format), ##__VA_ARGS__ )
+#else
+#define LOG_ERROR(format, ...)  do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...)   LogWrite( 'W', PSTR(format), ##__VA_ARGS__ )
+#else
+#define LOG_WARN(format, ...)   do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...)   LogWrite( 'I', PSTR(format), ##__VA_ARGS__ )
+#else
+#define LOG_INFO(format, ...)   do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...)  LogWrite( 'D', PSTR(format), ##__VA_ARGS__ )
+#else
+#define LOG_DEBUG(format, ...)  do {} while (0)
+#endif
+
+void LogWrite( char tag, PGM_P format, ... );
+void LogTask();
+unsigned long LogGetDroppedCount();
+
+#endif // LOG_H
@@ -0,0 +1,33 @@
+// ----------------------------------------------------------------------------
+// MemoryMonitor
+// Free SRAM and the deepest stack use since reset.
+//
+// The Mega has 8 KB of SRAM. The globals sit at the bottom, the heap grows
+// up from their end and the stack grows down from the top. The controller
+// runs for days, so the heap is not used at all: no String, no new, and
+// text is formatted into buffers on the stack. This module shows that the
+// memory use stays flat.
+//
+// Before the C runtime starts, MemoryMonitorPaint() fills everything
+// between the end of the globals and the top of the stack with
+// MEMORY_MONITOR_CANARY. The bytes the stack has never reached still hold
+// that value, so counting them from the end of the heap gives the smallest
+// gap between heap and stack there has ever been. A stack variable that
+// happens to hold the canary value can hide a few bytes, the value is a
+// lower bound of the stack use.
+//
+// The size of the stack frame of every function is written to the .su
+// files next to the object files by -fstack-usage at build time.
+// ----------------------------------------------------------------------------
+
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <Arduino.h>
+
+#define MEMORY_MONITOR_CANARY   0xC5    // the value the unused SRAM is painted with
+
+unsigned int MemoryMonitorGetFree();
+unsigned int MemoryMonitorGetLowestFree();
+
+#endif // MEMORYMONITOR_H
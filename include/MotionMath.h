@@ -0,0 +1,30 @@
+// ----------------------------------------------------------------------------
+// MotionMath
+// Integer only speed and interpolation math for the motor.
+//
+// The AVR has no floating point unit, every float or double operation pulls
+// in the soft float library and costs hundreds of cycles. These routines only
+// use integer math and unsigned 16.16 fixed point values (upper 16 bits the
+// integer part, lower 16 bits the fraction) and round to the nearest integer.
+// ----------------------------------------------------------------------------
+
+#ifndef MOTIONMATH_H
+#define MOTIONMATH_H
+
+#include <Arduino.h>
+
+#define FIXED16_ONE     0x10000UL   // 1.0 as unsigned 16.16 fixed point value
+
+typedef unsigned long ufixed16_t;  // unsigned 16.16 fixed point value
+
+unsigned long MotionMathRPM2Delay( unsigned int rpm, unsigned int ppr );
+unsigned int MotionMathDelay2RPM( unsigned long pulseDelay, unsigned int ppr );
+long MotionMathLinearMap( long ax, long aMin, long aMax, long bMin, long bMax );
+unsigned long MotionMathPercent( unsigned long value, uint8_t percent );
+ufixed16_t MotionMathRatio16( unsigned int numerator, unsigned int denominator );
+unsigned int MotionMathLerp16( unsigned int from, unsigned int to, unsigned int fraction );
+unsigned int MotionMathFraction16( unsigned long numerator, unsigned long denominator );
+unsigned int MotionMathSCurve16( unsigned int fraction );
+unsigned long MotionMathTravelTime( unsigned long steps, unsigned long pulseDelay );
+
+#endif // MOTIONMATH_H
@@ -0,0 +1,46 @@
+// ----------------------------------------------------------------------------
+// PositionJournal
+// Keeps the position of the motor at rest over a power cycle.
+//
+// Without it the controller has to move to endstop A after every power-up
+// to find out where the lift is. The journal is a ring of records in the
+// EEPROM behind the ConfigStore. Each record holds a sequence number, the
+// position, a CRC over both, the marker and the target of a move. A new position always
+// goes into the next record, so the writes are spread over all records
+// and every cell sees only a fraction of the wear.
+//
+// PositionJournalSetRest() writes a new record with the rest marker set
+// once the motor has come to rest. PositionJournalSetMoving() replaces the
+// marker of the newest record by the moving marker and the target of the
+// move before the motor moves again. These few bytes are written right
+// away and not through the EepromWriter. At boot PositionJournalInit()
+// finds the newest record with a valid CRC. Only if its rest marker is
+// still set has the power been switched off with the motor standing at
+// the stored position. With the moving marker the motor is somewhere
+// between the stored position and the target, so homing may run at full
+// speed up to the lower one of both. A record that has been torn by a
+// power loss fails the CRC, and the record before it has its marker
+// replaced, so the controller homes then.
+//
+// The records themselves are written by the EepromWriter in the background.
+// Two RAM copies are used in turns, so a record that is still being written
+// never changes under the writer when the next one is started.
+// ----------------------------------------------------------------------------
+
+#ifndef POSITIONJOURNAL_H
+#define POSITIONJOURNAL_H
+
+#include <Arduino.h>
+
+#define POSITION_JOURNAL_ADDRESS    1024    // first EEPROM address, behind the shorter records of older versions at 128
+#define POSITION_JOURNAL_RECORDS    64      // number of records in the ring
+#define POSITION_JOURNAL_REST       0x5A    // the rest marker
+#define POSITION_JOURNAL_MOVING     0xA5    // the moving marker, the target of the move is stored, any other value means the motor may be anywhere
+
+void PositionJournalInit();
+bool PositionJournalGetRestPosition( unsigned long *position );
+bool PositionJournalGetLowestPosition( unsigned long *position );
+void PositionJournalSetRest( unsigned long position );
+void PositionJournalSetMoving( unsigned long target );
+
+#endif // POSITIONJOURNAL_H
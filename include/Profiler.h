@@ -0,0 +1,88 @@
+// ----------------------------------------------------------------------------
+// Profiler
+// Scoped timing probes that show where the cycles of the Mega go.
+//
+// PROFILE( probe ) at the top of a block measures the time until the end
+// of the block and adds it to the count, total, minimum and maximum of the
+// probe. The time is read from Timer5, which runs free with prescaler 8
+// like the jitter measurement of the StepEngine, so a probe costs two
+// register reads and a few additions and resolves 0.5 microseconds. A
+// single measurement longer than 32 ms wraps around and is wrong.
+//
+// The probes of the main loop include the time of the interrupts that
+// have hit them, the probes of the interrupts never overlap each other.
+// Probes may be nested, the outer one includes the inner one.
+//
+// With PROFILER_ENABLED 0 PROFILE() expands to nothing and the table is
+// not compiled in, the firmware is exactly the same as without probes.
+// ----------------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+// 1 compiles the probes in, override with -D PROFILER_ENABLED=1 in build_flags
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED    0
+#endif
+
+// the probes, the serial tool knows their names in this order
+enum ProfilerProbe
+{
+    PROFILER_LOOP,              // one pass of loop()
+    PROFILER_INPUT,             // InputTask(), the buttons and the encoder
+    PROFILER_SERIAL,            // SerialProtocolTask()
+    PROFILER_MOTION,            // MotionTask()
+    PROFILER_ENDSTOPS,          // CheckEndStopA() and CheckEndStopB()
+    PROFILER_UI,                // UiTask(), includes drawing the screens
+    PROFILER_DRAW_TEXT,         // DisplayMessage() and DisplayNumber()
+    PROFILER_DISPLAY,           // DisplayTask(), sending to the LCD
+    PROFILER_EEPROM,            // EepromWriterTask()
+    PROFILER_TIMER_ISR,         // InterruptTimerCallback(), every millisecond
+    PROFILER_ENCODER,           // rotaryEncoder.service() in the timer interrupt
+    PROFILER_BUTTONS,           // ButtonScannerService() in the timer interrupt
+    PROFILER_STEP_ISR,          // the step interrupt of the StepEngine
+    PROFILER_RAMP,              // the ramp math of a step
+    PROFILER_PROBES
+};
+
+// the statistics of a probe, times in Timer5 ticks of 0.5 microseconds
+struct ProfilerStats
+{
+    unsigned long count;        // number of measurements, stops counting at 0xFFFFFFFF
+    unsigned long long total;   // sum of all measurements
+    uint16_t min;               // the shortest measurement
+    uint16_t max;               // the longest measurement
+};
+
+#if PROFILER_ENABLED
+
+void ProfilerInit();
+void ProfilerReset();
+void ProfilerGet( byte probe, ProfilerStats *stats );
+void ProfilerAdd( byte probe, uint16_t ticks );
+
+// measures from its construction to the end of the enclosing block
+class ProfilerScope
+{
+    public:
+        ProfilerScope( byte probe ) : probe( probe ), start( TCNT5 ) {}
+        ~ProfilerScope() { ProfilerAdd( probe, TCNT5 - start ); }
+
+    private:
+        byte probe;
+        uint16_t start;
+};
+
+#define PROFILER_CONCAT(a, b)   a##b
+#define PROFILER_NAME(line)     PROFILER_CONCAT(profilerScope, line)
+#define PROFILE(probe)          ProfilerScope PROFILER_NAME(__LINE__)( probe )
+
+#else
+
+#define PROFILE(probe)          do {} while (0)
+
+#endif // PROFILER_ENABLED
+
+#endif // PROFILER_H
@@ -0,0 +1,35 @@
+// ----------------------------------------------------------------------------
+// RampTable
+// Precomputed acceleration profile for the StepEngine.
+//
+// The table holds the pulse delay in microseconds for the ramp steps 0 to
+// accelSteps. It is built once whenever the motor settings change, so the
+// step interrupt only needs an integer lookup per step instead of floating
+// point math. Ramp tables longer than RAMP_TABLE_SIZE are interpolated
+// linearly between two entries.
+//
+// Two profiles are available:
+// RAMP_PROFILE_LINEAR  the pulse delay falls linearly with every step
+// RAMP_PROFILE_SCURVE  jerk limited S-curve, the acceleration rises and falls
+//                      smoothly so the lift does not jolt at the start and
+//                      the end of the ramp. The StepEngine mirrors the ramp
+//                      for braking, which gives the 7 phases of the profile.
+// ----------------------------------------------------------------------------
+
+#ifndef RAMPTABLE_H
+#define RAMPTABLE_H
+
+#include <Arduino.h>
+
+#define RAMP_TABLE_SIZE     256     // number of entries in the table, 2 bytes each
+
+#define RAMP_PROFILE_LINEAR 0
+#define RAMP_PROFILE_SCURVE 1
+#define RAMP_PROFILE_COUNT  2
+
+void RampTableBuild( unsigned int startDelay, unsigned int endDelay, unsigned int accelSteps, byte profile );
+unsigned int RampTableLookup( unsigned int rampStep );
+unsigned int RampTableFindStep( unsigned long pulseDelay );
+unsigned int RampTableGetAccelSteps();
+
+#endif // RAMPTABLE_H
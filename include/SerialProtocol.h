@@ -0,0 +1,107 @@
+// ----------------------------------------------------------------------------
+// SerialProtocol
+// Framed binary commands over the USB serial port.
+//
+// Every frame, in both directions, looks like this:
+//
+//   0xA5 | length | command | sequence | payload (length bytes) | crc
+//
+// length is the number of payload bytes (at most SERIAL_PROTOCOL_MAX_PAYLOAD),
+// crc is the CRC-8 (polynomial 0x07, start value 0) of length, command,
+// sequence and payload. Multi byte values are little endian.
+//
+// SerialProtocolTask() is called once per loop. It parses all bytes that
+// have arrived since the last call one by one, so a frame may arrive in any
+// number of pieces, and calls the handler for every complete frame with a
+// valid CRC. A frame with a wrong CRC is answered with
+// SERIAL_PROTOCOL_STATUS_BAD_CRC, an incomplete frame is dropped after
+// SERIAL_PROTOCOL_TIMEOUT milliseconds.
+//
+// Replies and notifications are queued by SerialProtocolSend() and handed
+// to the UART as whole frames as soon as they fit into its TX buffer, so
+// sending never blocks and the log text that shares the port never ends up
+// inside a frame. The log text is plain ASCII and never contains the start
+// byte 0xA5. A reply that does not fit into the queue is dropped and
+// counted, SerialProtocolTask() logs the number, so a host that runs into
+// its timeout can see why.
+// ----------------------------------------------------------------------------
+
+#ifndef SERIALPROTOCOL_H
+#define SERIALPROTOCOL_H
+
+#include <Arduino.h>
+
+#define SERIAL_PROTOCOL_BAUD            115200  // baud rate of the USB serial port
+#define SERIAL_PROTOCOL_START           0xA5    // first byte of every frame
+#define SERIAL_PROTOCOL_MAX_PAYLOAD     32      // the largest payload in bytes
+#define SERIAL_PROTOCOL_OVERHEAD        5       // bytes of a frame besides the payload
+#define SERIAL_PROTOCOL_TX_SIZE         128     // bytes of frames waiting for the UART
+#define SERIAL_PROTOCOL_TIMEOUT         50      // milliseconds until an incomplete frame is dropped
+
+// commands from the host
+#define SERIAL_PROTOCOL_CMD_PING        0x01    // -> version
+#define SERIAL_PROTOCOL_CMD_GOTO        0x10    // position (4), flags (1)
+#define SERIAL_PROTOCOL_CMD_GOTO_SLOT   0x11    // slot 0..11 (1), flags (1)
+#define SERIAL_PROTOCOL_CMD_JOG         0x12    // signed steps (4)
+#define SERIAL_PROTOCOL_CMD_STOP        0x13
+#define SERIAL_PROTOCOL_CMD_STATUS      0x20    // -> ui state (1), motion state (1), position (4), target (4), queued (1), flags (1)
+#define SERIAL_PROTOCOL_CMD_TELEMETRY   0x21    // period in ms (2), 0 = off -> period (2)
+#define SERIAL_PROTOCOL_CMD_MEMORY      0x22    // -> free SRAM now (2), lowest free SRAM since reset (2)
+#define SERIAL_PROTOCOL_CMD_DRIFT       0x23    // endstop 0 = A, 1 = B (1) -> endstop (1), trips (2), last (4), min (4), max (4), mean absolute (4)
+#define SERIAL_PROTOCOL_CMD_DRIFT_RESET 0x24    // clears the drift statistics of both endstops
+#define SERIAL_PROTOCOL_CMD_JITTER      0x25    // action (1) -> on (1), steps (4), move steps (2), move min (2), move max (2), move mean (2), 8 bins (2 each)
+#define SERIAL_PROTOCOL_CMD_PROFILE     0x26    // probe (1) -> probe (1), count (4), total (8), min (2), max (2), times in 0.5 us, only with PROFILER_ENABLED
+#define SERIAL_PROTOCOL_CMD_PROFILE_RESET 0x27  // clears the statistics of all probes, only with PROFILER_ENABLED
+#define SERIAL_PROTOCOL_CMD_GET_SETTING 0x30    // setting (1) -> setting (1), value (2)
+#define SERIAL_PROTOCOL_CMD_SET_SETTING 0x31    // setting (1), value (2)
+#define SERIAL_PROTOCOL_CMD_GET_SLOT    0x32    // slot (1) -> slot (1), position (4)
+#define SERIAL_PROTOCOL_CMD_SET_SLOT    0x33    // slot (1), position (4)
+
+// every command is answered with its code plus SERIAL_PROTOCOL_REPLY and the same
+// sequence number, the first payload byte of the reply is the status
+#define SERIAL_PROTOCOL_REPLY           0x80
+
+// notifications are sent without a request and use sequence number 0
+#define SERIAL_PROTOCOL_NOTIFY_MOVE_DONE 0xC0   // reason (1), position (4)
+#define SERIAL_PROTOCOL_NOTIFY_TELEMETRY 0xC1   // time in ms (2), position (4), pulse delay in us (4), target (4), flags (1), motor mode (1), motion state (1)
+
+// flags in SERIAL_PROTOCOL_CMD_STATUS and SERIAL_PROTOCOL_NOTIFY_TELEMETRY
+#define SERIAL_PROTOCOL_FLAG_RUNNING    0x01    // the motor is stepping
+#define SERIAL_PROTOCOL_FLAG_ENDSTOP_A  0x02    // endstop A is closed
+#define SERIAL_PROTOCOL_FLAG_ENDSTOP_B  0x04    // endstop B is closed
+#define SERIAL_PROTOCOL_FLAG_DIRECTION  0x08    // the motor moves towards endstop A
+
+// reasons in SERIAL_PROTOCOL_NOTIFY_MOVE_DONE
+#define SERIAL_PROTOCOL_MOVE_REACHED    0       // the last target has been reached
+#define SERIAL_PROTOCOL_MOVE_STOPPED    1       // the move has been stopped by a button or SERIAL_PROTOCOL_CMD_STOP
+#define SERIAL_PROTOCOL_MOVE_ENDSTOP    2       // an endstop has stopped the move
+
+// flags of SERIAL_PROTOCOL_CMD_GOTO and SERIAL_PROTOCOL_CMD_GOTO_SLOT
+#define SERIAL_PROTOCOL_GOTO_NOW        0x01    // drop the queued targets and head for the new one right away
+
+// actions of SERIAL_PROTOCOL_CMD_JITTER, deviations are in 0.5 us, bin n counts deviations below 2^n us
+#define SERIAL_PROTOCOL_JITTER_READ     0       // only read the measurement
+#define SERIAL_PROTOCOL_JITTER_ON       1       // clear the measurement and switch it on
+#define SERIAL_PROTOCOL_JITTER_OFF      2       // switch the measurement off, the values are kept
+
+// status byte of the replies
+#define SERIAL_PROTOCOL_STATUS_OK           0
+#define SERIAL_PROTOCOL_STATUS_BAD_CRC      1
+#define SERIAL_PROTOCOL_STATUS_BAD_LENGTH   2
+#define SERIAL_PROTOCOL_STATUS_BAD_VALUE    3
+#define SERIAL_PROTOCOL_STATUS_BUSY         4   // the controller is in a menu or moves on its own
+#define SERIAL_PROTOCOL_STATUS_UNKNOWN      5   // unknown command
+#define SERIAL_PROTOCOL_STATUS_QUEUE_FULL   6
+
+#define SERIAL_PROTOCOL_VERSION         1
+
+// called for every received frame, payload is only valid during the call
+typedef void (*SerialProtocolHandler)( byte command, byte sequence, const byte *payload, byte length );
+
+void SerialProtocolInit( SerialProtocolHandler handler );
+void SerialProtocolTask();
+bool SerialProtocolSend( byte command, byte sequence, const void *payload, byte length );
+bool SerialProtocolReply( byte command, byte sequence, byte status, const void *data = NULL, byte length = 0 );
+unsigned long SerialProtocolGetDroppedCount();
+
+#endif // SERIALPROTOCOL_H
@@ -0,0 +1,85 @@
+// ----------------------------------------------------------------------------
+// StepEngine
+// Interrupt driven step pulse generator for the motor driver.
+//
+// Runs on the 16 bit Timer3 of the Arduino Mega (Timer1 is used by TimerOne
+// for the rotary encoder). The compare match A interrupt raises PUL and loads
+// the already prepared next step interval. Right after raising PUL it moves
+// compare match B STEP_ENGINE_PULSE_WIDTH microseconds behind the counter,
+// so the pulse keeps its full width even if another interrupt has delayed
+// compare match A, and the next pulse never comes before PUL has been low
+// for the same time. StepEngineStop() also lets a pulse that is high run
+// out its width. So the CPU is free while the motor moves and the step
+// timing does not depend on the main loop.
+//
+// The engine owns the current step position and the motor direction.
+//
+// The endstops are read in the interrupt right before every pulse and the
+// engine refuses to step towards a closed endstop. It stops at once and
+// latches the event together with the position, so there is no overtravel
+// at any speed.
+//
+// Profiled moves take their pulse delays from the RampTable. The interrupt
+// keeps the current ramp step and decides per step whether to accelerate,
+// cruise or decelerate, so the deceleration always starts from the speed
+// that has actually been reached. StepEngineSetTarget() moves the end of a
+// running profiled move, so a new target can be taken over from the current
+// position and speed.
+//
+// With the jitter measurement switched on, the interrupt reads the free
+// running Timer5 right after raising PUL. The time since the last rising
+// edge is compared with the interval that has been loaded for it. The
+// difference is counted in a histogram and in the minimum, maximum and sum
+// of the current move. Both timers count the same 0.5 microsecond ticks, so
+// the difference is exactly the extra latency of this pulse against the
+// one before it. Intervals longer than 16 bit of Timer5 are not measured.
+// ----------------------------------------------------------------------------
+
+#ifndef STEPENGINE_H
+#define STEPENGINE_H
+
+#include <Arduino.h>
+
+#define STEP_ENGINE_PULSE_WIDTH     20      // width of the PUL pulse in microseconds
+#define STEP_ENGINE_MIN_INTERVAL    40      // the shortest step interval in microseconds the engine accepts
+#define STEP_ENGINE_CONTINUOUS      0       // pass as steps to StepEngineStart() to step until StepEngineStop()
+
+#define STEP_ENGINE_JITTER_BINS     8       // bin n counts deviations below 2^n microseconds, the last one all others
+
+#define STEP_ENGINE_ENDSTOP_NONE    0
+#define STEP_ENGINE_ENDSTOP_A       1       // endstop at position 0, blocks the HIGH direction
+#define STEP_ENGINE_ENDSTOP_B       2       // endstop at the other end, blocks the LOW direction
+
+// the deviations of the real step intervals from the loaded ones, in Timer5 ticks of 0.5 microseconds
+struct StepEngineJitter
+{
+    bool enabled;                                   // true while the measurement is switched on
+    unsigned long steps;                            // the measured steps since StepEngineJitterEnable()
+    unsigned int bins[STEP_ENGINE_JITTER_BINS];     // the histogram of the absolute deviations, stops counting at 0xFFFF
+    unsigned int moveSteps;                         // the measured steps of the current or last move
+    int moveMin;                                    // the smallest deviation of the move
+    int moveMax;                                    // the largest deviation of the move
+    long moveSum;                                   // the sum of the deviations of the move, for the mean
+};
+
+void StepEngineInit( uint8_t pulPin, uint8_t dirPin );
+void StepEngineSetEndStops( uint8_t pinA, uint8_t pinB );
+void StepEngineStart( unsigned long steps, unsigned long interval );
+void StepEngineStartProfile( unsigned long steps, unsigned long cruiseInterval );
+void StepEngineSetCruiseInterval( unsigned long cruiseInterval );
+bool StepEngineSetTarget( unsigned long targetPosition );
+void StepEngineStop();
+void StepEngineSetInterval( unsigned long interval );
+unsigned long StepEngineGetInterval();
+void StepEngineSetDirection( bool direction );
+bool StepEngineGetDirection();
+bool StepEngineIsRunning();
+unsigned long StepEngineGetPosition();
+void StepEngineSetPosition( unsigned long position );
+unsigned long StepEngineGetStepsDone();
+bool StepEngineTakeEndStopEvent( uint8_t endStop );
+unsigned long StepEngineGetEndStopPosition();
+void StepEngineJitterEnable( bool enabled );
+void StepEngineGetJitter( StepEngineJitter *jitter );
+
+#endif // STEPENGINE_H
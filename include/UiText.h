@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------------
+// UiText
+// The texts of the user interface in every language, all of them in flash.
+//
+// Every text has an id and one entry per language in a table in PROGMEM,
+// so a text costs no SRAM at all, neither the strings nor the table. A new
+// language only needs another column in the table. The only byte in SRAM is
+// the selected language.
+//
+// UiTextGet() returns the address of the text in flash. Pass UI_TEXT(id) to
+// DisplayMessage() or the address to snprintf_P() for texts with a format.
+// ----------------------------------------------------------------------------
+
+#ifndef UITEXT_H
+#define UITEXT_H
+
+#include <Arduino.h>
+
+#define UI_TEXT_GERMAN          0
+#define UI_TEXT_ENGLISH         1
+#define UI_TEXT_LANGUAGE_COUNT  2
+
+// a text of the current language for the Print functions
+#define UI_TEXT(id) ((const __FlashStringHelper *)UiTextGet(id))
+
+enum UiTextId
+{
+    UI_TEXT_LOKLIFT,
+    UI_TEXT_CONTROLLER,
+    UI_TEXT_STARTING,
+    UI_TEXT_HOMING,
+    UI_TEXT_TRACK_CLEAR,
+    UI_TEXT_POSITION,
+    UI_TEXT_OUT_OF_RANGE,
+    UI_TEXT_DONE,
+    UI_TEXT_TARGET_SLOT,        // format, the button number (%d)
+    UI_TEXT_TARGET_POSITION,    // format, the position (%lu)
+    UI_TEXT_POSITION_VALUE,     // format, the position (%lu), 14 characters
+    UI_TEXT_SPEED,              // format, the rounds per minute (%u), 14 characters
+    UI_TEXT_MEASURE_TRACK,
+    UI_TEXT_ENDSTOP_A,
+    UI_TEXT_ENDSTOP_B,
+    UI_TEXT_SAVED,
+    UI_TEXT_DRIVE_MODE,
+    UI_TEXT_STEP_MODE,
+    UI_TEXT_SAVE_POSITION,
+    UI_TEXT_SAVE_QUESTION,
+    UI_TEXT_BUTTON,
+    UI_TEXT_CANCELLED,
+    UI_TEXT_SETTING_MAX_RPM,    // the labels of the settings menu in the order of its rows
+    UI_TEXT_SETTING_MIN_RPM,
+    UI_TEXT_SETTING_CAL_RPM,
+    UI_TEXT_SETTING_ACCEL_STEPS,
+    UI_TEXT_SETTING_PPR,
+    UI_TEXT_SETTING_PROFILE,
+    UI_TEXT_SETTING_LIMIT,
+    UI_TEXT_SETTING_LANGUAGE,
+    UI_TEXT_PROFILE_LINEAR,
+    UI_TEXT_PROFILE_SCURVE,
+    UI_TEXT_LANGUAGE_NAME,      // the name of the language in the settings menu
+    UI_TEXT_COUNT
+};
+
+void UiTextSetLanguage( byte language );
+PGM_P UiTextGet( UiTextId id );
+
+#endif // UITEXT_H
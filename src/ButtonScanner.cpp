@@ -0,0 +1,150 @@
+#include "ButtonScanner.h"
+#include <util/atomic.h>
+
+/********** GLOBALS ******************************************************/
+static volatile uint8_t *SCAN_PORTS[BUTTON_SCANNER_MAX_PORTS];     // the input registers that hold the inputs
+static uint8_t SCAN_PORT_COUNT                  = 0;        // number of input registers to read
+static uint8_t SCAN_PORT_INDEX[BUTTON_SCANNER_MAX_INPUTS];  // index into SCAN_PORTS per input
+static uint8_t SCAN_MASK[BUTTON_SCANNER_MAX_INPUTS];        // bit mask of the pin per input
+static uint8_t SCAN_INPUT_COUNT                 = 0;        // number of inputs, 0 until ButtonScannerInit()
+static uint8_t SCAN_TICKS                       = 0;        // milliseconds since the last sample
+
+static uint16_t SCAN_COUNTER_0                  = 0xFFFF;   // low bits of the vertical counters
+static uint16_t SCAN_COUNTER_1                  = 0xFFFF;   // high bits of the vertical counters
+static volatile uint16_t SCAN_STATE             = 0;        // debounced state, 1 = closed
+static volatile uint16_t SCAN_PRESSED           = 0;        // inputs that have closed since the last ButtonScannerTakePressed()
+static volatile uint16_t SCAN_RELEASED          = 0;        // inputs that have opened since the last ButtonScannerTakeReleased()
+/*************************************************************************/
+
+
+/*****************************************************
+ * ButtonScannerSample()
+ * Reads every input register once and returns the raw
+ * state of all inputs, 1 = closed
+ */
+static inline uint16_t ButtonScannerSample()
+{
+    uint8_t portValues[BUTTON_SCANNER_MAX_PORTS];
+    for (uint8_t p = 0; p < SCAN_PORT_COUNT; p++) { portValues[p] = *SCAN_PORTS[p]; }
+
+    uint16_t sample = 0;
+    for (uint8_t i = 0; i < SCAN_INPUT_COUNT; i++)
+    {
+        if ( ( portValues[SCAN_PORT_INDEX[i]] & SCAN_MASK[i] ) == 0 ) { sample |= (uint16_t)1 << i; }
+    }
+
+    return sample;
+}
+
+
+/*****************************************************
+ * ButtonScannerInit( const uint8_t *pins, uint8_t count )
+ * Sets up the input pins with pullups
+ *
+ * pins: the Arduino pin numbers, pins[i] becomes bit i of the masks
+ * count: number of pins, at most BUTTON_SCANNER_MAX_INPUTS
+ */
+void ButtonScannerInit( const uint8_t *pins, uint8_t count )
+{
+    if ( count > BUTTON_SCANNER_MAX_INPUTS ) { count = BUTTON_SCANNER_MAX_INPUTS; }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        SCAN_PORT_COUNT = 0;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            pinMode(pins[i], INPUT_PULLUP);
+
+            // every input register is only read once per sample
+            volatile uint8_t *port = portInputRegister( digitalPinToPort(pins[i]) );
+            uint8_t p = 0;
+            while ( p < SCAN_PORT_COUNT && SCAN_PORTS[p] != port ) { p++; }
+            if ( p == SCAN_PORT_COUNT && SCAN_PORT_COUNT < BUTTON_SCANNER_MAX_PORTS ) { SCAN_PORTS[SCAN_PORT_COUNT++] = port; }
+
+            SCAN_PORT_INDEX[i] = p;
+            SCAN_MASK[i] = digitalPinToBitMask(pins[i]);
+        }
+
+        SCAN_INPUT_COUNT = count;
+
+        // inputs that are already closed at start do not report a press
+        SCAN_STATE = ButtonScannerSample();
+        SCAN_COUNTER_0 = 0xFFFF;
+        SCAN_COUNTER_1 = 0xFFFF;
+        SCAN_PRESSED = 0;
+        SCAN_RELEASED = 0;
+    }
+}
+
+
+/*****************************************************
+ * ButtonScannerService()
+ * Call every millisecond from the timer interrupt
+ */
+void ButtonScannerService()
+{
+    if ( SCAN_INPUT_COUNT == 0 ) { return; }
+
+    if ( ++SCAN_TICKS < BUTTON_SCANNER_INTERVAL ) { return; }
+    SCAN_TICKS = 0;
+
+    // the counters of unchanged inputs are reset to 3, the counters
+    // of changed inputs count down and toggle the state when they roll over
+    uint16_t changed = SCAN_STATE ^ ButtonScannerSample();
+    SCAN_COUNTER_0 = ~( SCAN_COUNTER_0 & changed );
+    SCAN_COUNTER_1 = SCAN_COUNTER_0 ^ ( SCAN_COUNTER_1 & changed );
+    changed &= SCAN_COUNTER_0 & SCAN_COUNTER_1;
+
+    uint16_t state = SCAN_STATE ^ changed;
+    SCAN_STATE = state;
+    SCAN_PRESSED |= state & changed;
+    SCAN_RELEASED |= ~state & changed;
+}
+
+
+/*****************************************************
+ * ButtonScannerTakePressed()
+ * returns the inputs that have been pressed since the last call
+ */
+uint16_t ButtonScannerTakePressed()
+{
+    uint16_t pressed;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pressed = SCAN_PRESSED;
+        SCAN_PRESSED = 0;
+    }
+    return pressed;
+}
+
+
+/*****************************************************
+ * ButtonScannerTakeReleased()
+ * returns the inputs that have been released since the last call
+ */
+uint16_t ButtonScannerTakeReleased()
+{
+    uint16_t released;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        released = SCAN_RELEASED;
+        SCAN_RELEASED = 0;
+    }
+    return released;
+}
+
+
+/*****************************************************
+ * ButtonScannerGetState()
+ * returns the debounced state of all inputs, 1 = closed
+ */
+uint16_t ButtonScannerGetState()
+{
+    uint16_t state;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        state = SCAN_STATE;
+    }
+    return state;
+}
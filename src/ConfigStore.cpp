@@ -0,0 +1,37 @@
+#include "ConfigStore.h"
+#include "EepromWriter.h"
+#include <avr/eeprom.h>
+
+// the addresses of the values must never change, the EEPROM of existing controllers holds them
+static_assert( sizeof(ConfigStoreData) == 102, "the EEPROM layout has changed" );
+
+/********** GLOBALS ******************************************************/
+ConfigStoreData CONFIG;                                     // the RAM copy of the EEPROM, read it directly
+/*************************************************************************/
+
+
+/*****************************************************
+ * ConfigStoreLoad()
+ * Reads all values from the EEPROM into CONFIG
+ */
+void ConfigStoreLoad()
+{
+    eeprom_read_block( &CONFIG, (const void *)0, sizeof(CONFIG) );
+}
+
+
+/*****************************************************
+ * ConfigStoreSave( const void *field, byte length )
+ * Queues a changed field of CONFIG to be written back,
+ * use CONFIG_STORE_SAVE( field )
+ *
+ * field: the address of the field inside CONFIG
+ * length: the size of the field
+ */
+void ConfigStoreSave( const void *field, byte length )
+{
+    // the offset inside CONFIG is the EEPROM address
+    int address = (const byte *)field - (const byte *)&CONFIG;
+
+    EepromWriterSchedule( address, field, length );
+}
@@ -0,0 +1,184 @@
+#include "DisplayBuffer.h"
+
+// the frame buffer of Adafruit_PCD8544.cpp, it starts with the Adafruit logo
+extern uint8_t pcd8544_buffer[LCDWIDTH * LCDHEIGHT / 8];
+
+static_assert( LCDWIDTH == DISPLAY_BUFFER_WIDTH && LCDHEIGHT == DISPLAY_BUFFER_HEIGHT, "the LCD has another size" );
+
+
+/*****************************************************
+ * DisplayBuffer( Adafruit_PCD8544 &lcd )
+ * lcd: the initialised LCD the buffer is sent to
+ */
+DisplayBuffer::DisplayBuffer( Adafruit_PCD8544 &lcd ) : Adafruit_GFX( DISPLAY_BUFFER_WIDTH, DISPLAY_BUFFER_HEIGHT ), lcd( lcd ), buffer( pcd8544_buffer ), flushBank( 0 ), worstSlice( 0 )
+{
+    memset( buffer, 0, DISPLAY_BUFFER_BANKS * DISPLAY_BUFFER_WIDTH );
+
+    // the LCD shows something else after reset, the first flush sends everything
+    invalidate();
+}
+
+
+/*****************************************************
+ * markDirty( uint8_t bank, uint8_t firstColumn, uint8_t lastColumn )
+ * Widens the dirty column range of a bank
+ */
+void DisplayBuffer::markDirty( uint8_t bank, uint8_t firstColumn, uint8_t lastColumn )
+{
+    if ( firstColumn < dirtyFirst[bank] ) { dirtyFirst[bank] = firstColumn; }
+    if ( lastColumn > dirtyLast[bank] ) { dirtyLast[bank] = lastColumn; }
+}
+
+
+/*****************************************************
+ * drawPixel( int16_t x, int16_t y, uint16_t color )
+ * Sets a pixel in the buffer, all drawing of Adafruit_GFX ends up here
+ * color: BLACK or WHITE
+ */
+void DisplayBuffer::drawPixel( int16_t x, int16_t y, uint16_t color )
+{
+    if ( x < 0 || x >= DISPLAY_BUFFER_WIDTH || y < 0 || y >= DISPLAY_BUFFER_HEIGHT ) { return; }
+
+    uint8_t bank = y >> 3;
+    uint8_t mask = 1 << (y & 7);
+    uint8_t &column = buffer[bank * DISPLAY_BUFFER_WIDTH + x];
+    uint8_t value = color == WHITE ? column & ~mask : column | mask;
+
+    // a pixel that does not change costs no transfer
+    if ( value == column ) { return; }
+
+    column = value;
+    markDirty( bank, x, x );
+}
+
+
+/*****************************************************
+ * fillScreen( uint16_t color )
+ * Fills the whole buffer byte by byte instead of pixel by pixel
+ */
+void DisplayBuffer::fillScreen( uint16_t color )
+{
+    uint8_t value = color == WHITE ? 0x00 : 0xFF;
+
+    for (uint8_t bank = 0; bank < DISPLAY_BUFFER_BANKS; bank++)
+    {
+        uint8_t *row = buffer + bank * DISPLAY_BUFFER_WIDTH;
+
+        for (uint8_t x = 0; x < DISPLAY_BUFFER_WIDTH; x++)
+        {
+            if ( row[x] == value ) { continue; }
+            row[x] = value;
+            markDirty( bank, x, x );
+        }
+    }
+}
+
+
+/*****************************************************
+ * clearDisplay()
+ * Clears the buffer, like Adafruit_PCD8544::clearDisplay()
+ */
+void DisplayBuffer::clearDisplay()
+{
+    fillScreen( WHITE );
+}
+
+
+/*****************************************************
+ * invalidate()
+ * Marks the whole screen dirty, e.g. after the LCD has been reset
+ */
+void DisplayBuffer::invalidate()
+{
+    for (uint8_t bank = 0; bank < DISPLAY_BUFFER_BANKS; bank++)
+    {
+        dirtyFirst[bank] = 0;
+        dirtyLast[bank] = DISPLAY_BUFFER_WIDTH - 1;
+    }
+}
+
+
+/*****************************************************
+ * isDirty()
+ * returns true if any part of the buffer has not been sent yet
+ */
+bool DisplayBuffer::isDirty()
+{
+    for (uint8_t bank = 0; bank < DISPLAY_BUFFER_BANKS; bank++)
+    {
+        if ( dirtyFirst[bank] <= dirtyLast[bank] ) { return true; }
+    }
+
+    return false;
+}
+
+
+/*****************************************************
+ * flush( unsigned long budget )
+ * Sends the dirty column ranges of the banks to the LCD
+ * returns the number of data bytes sent
+ *
+ * budget: microseconds this call may take, at least one byte
+ *         is sent per call, 0 sends everything at once
+ */
+unsigned int DisplayBuffer::flush( unsigned long budget )
+{
+    unsigned long start = micros();
+    unsigned int sent = 0;
+
+    // a slice starts where the last one stopped, so every bank gets its turn
+    for (uint8_t i = 0; i < DISPLAY_BUFFER_BANKS; i++)
+    {
+        uint8_t bank = flushBank;
+        uint8_t first = dirtyFirst[bank];
+        uint8_t last = dirtyLast[bank];
+
+        if ( first <= last )
+        {
+            // the LCD moves to the next column after every data byte
+            lcd.command( PCD8544_SETYADDR | bank );
+            lcd.command( PCD8544_SETXADDR | first );
+
+            const uint8_t *row = buffer + bank * DISPLAY_BUFFER_WIDTH;
+            uint8_t x = first;
+
+            while ( x <= last )
+            {
+                if ( budget > 0 && sent > 0 && micros() - start >= budget ) { break; }
+                lcd.data( row[x] );
+                sent++;
+                x++;
+            }
+
+            // the rest of the range goes with the next slice
+            if ( x <= last )
+            {
+                dirtyFirst[bank] = x;
+                break;
+            }
+
+            dirtyFirst[bank] = DISPLAY_BUFFER_WIDTH;
+            dirtyLast[bank] = 0;
+        }
+
+        flushBank = (flushBank + 1) % DISPLAY_BUFFER_BANKS;
+    }
+
+    if ( budget > 0 && sent > 0 )
+    {
+        unsigned long duration = micros() - start;
+        if ( duration > worstSlice ) { worstSlice = duration; }
+    }
+
+    return sent;
+}
+
+
+/*****************************************************
+ * getWorstSlice()
+ * returns the longest flush() with a budget so far in microseconds
+ */
+unsigned long DisplayBuffer::getWorstSlice()
+{
+    return worstSlice;
+}
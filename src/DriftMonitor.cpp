@@ -0,0 +1,72 @@
+#include "DriftMonitor.h"
+#include "ConfigStore.h"
+#include "Log.h"
+
+
+/*****************************************************
+ * DriftMonitorInit()
+ * Call after ConfigStoreLoad(), clears the statistics of
+ * a controller that has never stored any
+ */
+void DriftMonitorInit()
+{
+    for (byte i = 0; i < CONFIG_STORE_ENDSTOPS; i++)
+    {
+        // an unwritten EEPROM cell reads 0xFF, only in RAM, the first trip writes it
+        if ( CONFIG.drift[i].count == 0xFFFF ) { memset( &CONFIG.drift[i], 0, sizeof(CONFIG.drift[i]) ); }
+    }
+}
+
+
+/*****************************************************
+ * DriftMonitorRecord( byte endStop, long drift )
+ * Adds the difference of an endstop trip to its statistics
+ *
+ * endStop: DRIFT_MONITOR_ENDSTOP_A or DRIFT_MONITOR_ENDSTOP_B
+ * drift: the latched position minus the expected position in steps
+ */
+void DriftMonitorRecord( byte endStop, long drift )
+{
+    ConfigStoreDrift &stats = CONFIG.drift[endStop];
+    unsigned long absDrift = drift < 0 ? -drift : drift;
+
+    if ( stats.count == 0 || drift < stats.min ) { stats.min = drift; }
+    if ( stats.count == 0 || drift > stats.max ) { stats.max = drift; }
+    stats.last = drift;
+
+    // both stop counting instead of overflowing, 0xFFFF is the unwritten value
+    if ( stats.count < 0xFFFE && stats.sumAbs + absDrift >= stats.sumAbs )
+    {
+        stats.count++;
+        stats.sumAbs += absDrift;
+    }
+
+    CONFIG_STORE_SAVE(drift[endStop]);
+
+    if ( absDrift > DRIFT_MONITOR_WARNING ) { LOG_WARN("Drift at endstop %c: %ld steps", 'A' + endStop, drift); }
+    else { LOG_INFO("Drift at endstop %c: %ld steps", 'A' + endStop, drift); }
+}
+
+
+/*****************************************************
+ * DriftMonitorReset()
+ * Clears the statistics of both endstops
+ */
+void DriftMonitorReset()
+{
+    memset( CONFIG.drift, 0, sizeof(CONFIG.drift) );
+    CONFIG_STORE_SAVE(drift);
+}
+
+
+/*****************************************************
+ * DriftMonitorGetMeanAbs( byte endStop )
+ * returns the mean of the absolute differences in steps
+ */
+unsigned long DriftMonitorGetMeanAbs( byte endStop )
+{
+    const ConfigStoreDrift &stats = CONFIG.drift[endStop];
+    if ( stats.count == 0 ) { return 0; }
+
+    return stats.sumAbs / stats.count;
+}
@@ -0,0 +1,88 @@
+#include "EepromWriter.h"
+#include "Profiler.h"
+#include <EEPROM.h>
+#include <avr/eeprom.h>
+
+struct EepromWriterEntry
+{
+    int address;                // EEPROM address of the value
+    const byte *source;         // RAM location of the value
+    byte length;                // size of the value in bytes
+    byte written;               // number of bytes written so far
+};
+
+/********** GLOBALS ******************************************************/
+static EepromWriterEntry EEPROM_WRITER_QUEUE[EEPROM_WRITER_QUEUE_SIZE]; // the values waiting to be written
+static byte EEPROM_WRITER_HEAD                  = 0;        // queue index of the value that is written next
+static byte EEPROM_WRITER_COUNT                 = 0;        // number of values in the queue
+/*************************************************************************/
+
+
+/*****************************************************
+ * EepromWriterWriteByte()
+ * Writes the next byte of the first value in the queue
+ * and removes the value as soon as all of its bytes are written
+ */
+static void EepromWriterWriteByte()
+{
+    EepromWriterEntry &entry = EEPROM_WRITER_QUEUE[EEPROM_WRITER_HEAD];
+
+    // update() only writes if the stored byte differs
+    EEPROM.update( entry.address + entry.written, entry.source[entry.written] );
+    entry.written++;
+
+    if ( entry.written >= entry.length )
+    {
+        EEPROM_WRITER_HEAD = (EEPROM_WRITER_HEAD + 1) % EEPROM_WRITER_QUEUE_SIZE;
+        EEPROM_WRITER_COUNT--;
+    }
+}
+
+
+/*****************************************************
+ * EepromWriterSchedule( int address, const void *source, byte length )
+ * Queues length bytes at source to be written to the EEPROM at address
+ *
+ * address: the EEPROM address of the value
+ * source: the RAM location of the value, e.g. &TOTAL_TRACK_STEPS
+ * length: the size of the value, e.g. sizeof(TOTAL_TRACK_STEPS)
+ */
+void EepromWriterSchedule( int address, const void *source, byte length )
+{
+    // a value that is already queued is written again from its first byte,
+    // the bytes written so far may have changed in the meantime
+    for (byte i = 0; i < EEPROM_WRITER_COUNT; i++)
+    {
+        EepromWriterEntry &entry = EEPROM_WRITER_QUEUE[(EEPROM_WRITER_HEAD + i) % EEPROM_WRITER_QUEUE_SIZE];
+        if ( entry.address == address && entry.source == source && entry.length == length )
+        {
+            entry.written = 0;
+            return;
+        }
+    }
+
+    // a full queue is written right away to make room, this blocks
+    // but only happens if far more values are saved at once than usual
+    while ( EEPROM_WRITER_COUNT >= EEPROM_WRITER_QUEUE_SIZE ) { EepromWriterWriteByte(); }
+
+    EepromWriterEntry &entry = EEPROM_WRITER_QUEUE[(EEPROM_WRITER_HEAD + EEPROM_WRITER_COUNT) % EEPROM_WRITER_QUEUE_SIZE];
+    entry.address = address;
+    entry.source = (const byte *)source;
+    entry.length = length;
+    entry.written = 0;
+    EEPROM_WRITER_COUNT++;
+}
+
+
+/*****************************************************
+ * EepromWriterTask()
+ * Call once per loop, writes one byte if the EEPROM is ready
+ */
+void EepromWriterTask()
+{
+    PROFILE(PROFILER_EEPROM);
+
+    if ( EEPROM_WRITER_COUNT == 0 || !eeprom_is_ready() ) { return; }
+
+    EepromWriterWriteByte();
+}
@@ -0,0 +1,109 @@
+#include "Log.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+/********** GLOBALS ******************************************************/
+static char LOG_BUFFER[LOG_BUFFER_SIZE];                    // the ring buffer with the formatted messages
+static unsigned int LOG_HEAD                    = 0;        // buffer index of the next byte to send
+static unsigned int LOG_COUNT                   = 0;        // number of bytes waiting in the buffer
+static unsigned int LOG_DROPPED                 = 0;        // messages dropped since the last report
+static unsigned long LOG_DROPPED_TOTAL          = 0;        // messages dropped since the start
+/*************************************************************************/
+
+
+/*****************************************************
+ * LogPut( const char *text, unsigned int length )
+ * Appends length bytes to the ring buffer
+ * returns false and appends nothing if they do not fit
+ */
+static bool LogPut( const char *text, unsigned int length )
+{
+    if ( length > LOG_BUFFER_SIZE - LOG_COUNT ) { return false; }
+
+    unsigned int tail = (LOG_HEAD + LOG_COUNT) % LOG_BUFFER_SIZE;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        LOG_BUFFER[tail] = text[i];
+        tail = (tail + 1) % LOG_BUFFER_SIZE;
+    }
+    LOG_COUNT += length;
+
+    return true;
+}
+
+
+/*****************************************************
+ * LogWrite( char tag, PGM_P format, ... )
+ * Formats a message into the ring buffer, use the LOG_* macros instead
+ *
+ * tag: the level letter in front of the message
+ * format: printf format string in flash
+ */
+void LogWrite( char tag, PGM_P format, ... )
+{
+    char line[LOG_LINE_SIZE];
+    line[0] = tag;
+    line[1] = ' ';
+
+    // leave room for the line end
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf_P(line + 2, LOG_LINE_SIZE - 4, format, args);
+    va_end(args);
+
+    if ( length < 0 ) { return; }
+    if ( length > LOG_LINE_SIZE - 5 ) { length = LOG_LINE_SIZE - 5; }
+
+    length += 2;
+    line[length++] = '\r';
+    line[length++] = '\n';
+
+    if ( !LogPut(line, length) )
+    {
+        LOG_DROPPED++;
+        LOG_DROPPED_TOTAL++;
+    }
+}
+
+
+/*****************************************************
+ * LogTask()
+ * Call once per loop, moves as many bytes to the UART
+ * as fit into its TX buffer without blocking, except
+ * for LOG_UART_RESERVE
+ */
+void LogTask()
+{
+    // the report takes the place of the dropped messages as soon as there is room
+    if ( LOG_DROPPED > 0 && LOG_BUFFER_SIZE - LOG_COUNT >= LOG_LINE_SIZE )
+    {
+        unsigned int dropped = LOG_DROPPED;
+        LOG_DROPPED = 0;
+        LogWrite( 'W', PSTR("%u log messages dropped"), dropped );
+    }
+
+    int space = Serial.availableForWrite() - LOG_UART_RESERVE;
+
+    while ( space > 0 && LOG_COUNT > 0 )
+    {
+        // the part up to the end of the buffer is sent in one piece
+        unsigned int length = LOG_BUFFER_SIZE - LOG_HEAD;
+        if ( length > LOG_COUNT ) { length = LOG_COUNT; }
+        if ( length > (unsigned int)space ) { length = space; }
+
+        Serial.write( (const uint8_t *)&LOG_BUFFER[LOG_HEAD], length );
+        LOG_HEAD = (LOG_HEAD + length) % LOG_BUFFER_SIZE;
+        LOG_COUNT -= length;
+        space -= length;
+    }
+}
+
+
+/*****************************************************
+ * LogGetDroppedCount()
+ * returns the number of messages dropped since the start
+ */
+unsigned long LogGetDroppedCount()
+{
+    return LOG_DROPPED_TOTAL;
+}
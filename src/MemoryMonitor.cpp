@@ -0,0 +1,74 @@
+#include "MemoryMonitor.h"
+
+// symbols of the linker script and the heap of avr-libc
+extern uint8_t _end;            // end of .data and .bss
+extern uint8_t __stack;         // top of the stack, RAMEND
+extern uint8_t __heap_start;    // start of the heap
+extern char *__brkval;          // end of the heap, NULL as long as malloc() has not been called
+
+void MemoryMonitorPaint() __attribute__((naked, used, section(".init1")));
+
+
+/*****************************************************
+ * MemoryMonitorPaint()
+ * Fills the SRAM from the end of the globals up to the top of the
+ * stack with MEMORY_MONITOR_CANARY. Runs in .init1 before the zero
+ * register is set up and the stack is used, so it is assembler only.
+ */
+void MemoryMonitorPaint()
+{
+    __asm volatile (
+        "    ldi r30, lo8(_end)         \n"
+        "    ldi r31, hi8(_end)         \n"
+        "    ldi r24, %0                \n"
+        "    ldi r25, hi8(__stack)      \n"
+        "    rjmp 2f                    \n"
+        "1:  st Z+, r24                 \n"
+        "2:  cpi r30, lo8(__stack)      \n"
+        "    cpc r31, r25               \n"
+        "    brlo 1b                    \n"
+        "    breq 1b                    \n"
+        :: "M" (MEMORY_MONITOR_CANARY)
+    );
+}
+
+
+/*****************************************************
+ * MemoryMonitorHeapEnd()
+ * returns the first byte above the heap
+ */
+static uint8_t *MemoryMonitorHeapEnd()
+{
+    return __brkval != NULL ? (uint8_t *)__brkval : &__heap_start;
+}
+
+
+/*****************************************************
+ * MemoryMonitorGetFree()
+ * returns the bytes between the end of the heap and the
+ * stack pointer right now
+ */
+unsigned int MemoryMonitorGetFree()
+{
+    uint8_t top;
+
+    // the address of a local variable is the current end of the stack
+    return &top - MemoryMonitorHeapEnd();
+}
+
+
+/*****************************************************
+ * MemoryMonitorGetLowestFree()
+ * returns the smallest number of bytes there has been
+ * between the end of the heap and the stack since reset
+ */
+unsigned int MemoryMonitorGetLowestFree()
+{
+    const uint8_t *address = MemoryMonitorHeapEnd();
+    unsigned int count = 0;
+
+    // the stack has never reached the painted bytes right above the heap
+    while ( address + count <= &__stack && address[count] == MEMORY_MONITOR_CANARY ) { count++; }
+
+    return count;
+}
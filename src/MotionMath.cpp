@@ -0,0 +1,172 @@
+#include "MotionMath.h"
+
+#define MICROSECONDS_PER_MINUTE 60000000UL
+
+
+/*****************************************************
+ * MotionMathRPM2Delay( unsigned int rpm, unsigned int ppr )
+ * returns the pulse delay in microseconds for the rounds per minute
+ * rounded to the nearest microsecond
+ *
+ * rpm: rounds per minute, 1 to 65535
+ * ppr: pulses per revolution of the motor
+ */
+unsigned long MotionMathRPM2Delay( unsigned int rpm, unsigned int ppr )
+{
+    unsigned long pulsesPerMinute = (unsigned long)rpm * ppr;
+    if ( pulsesPerMinute == 0 ) { return MICROSECONDS_PER_MINUTE; }
+
+    return (MICROSECONDS_PER_MINUTE + pulsesPerMinute / 2) / pulsesPerMinute;
+}
+
+
+/*****************************************************
+ * MotionMathDelay2RPM( unsigned long pulseDelay, unsigned int ppr )
+ * returns the rounds per minute for a pulse delay in microseconds
+ * rounded to the nearest round per minute
+ */
+unsigned int MotionMathDelay2RPM( unsigned long pulseDelay, unsigned int ppr )
+{
+    unsigned long microsecondsPerRound = pulseDelay * ppr;
+    if ( microsecondsPerRound == 0 ) { return 0; }
+
+    return (MICROSECONDS_PER_MINUTE + microsecondsPerRound / 2) / microsecondsPerRound;
+}
+
+
+/*****************************************************
+ * MotionMathLinearMap( long ax, long aMin, long aMax, long bMin, long bMax )
+ * Maps value ax from range aMin/aMax into range bMin/bMax
+ * ax outside of aMin/aMax is clamped to the range
+ *
+ * (aMax - aMin) * |bMax - bMin| must fit into a long
+ */
+long MotionMathLinearMap( long ax, long aMin, long aMax, long bMin, long bMax )
+{
+    if ( ax >= aMax ) { return bMax; }
+    if ( ax <= aMin ) { return bMin; }
+
+    long range = aMax - aMin;
+    long product = (ax - aMin) * (bMax - bMin);
+
+    // round half away from zero
+    if ( product < 0 ) { return bMin - (-product + range / 2) / range; }
+    return bMin + (product + range / 2) / range;
+}
+
+
+/*****************************************************
+ * MotionMathPercent( unsigned long value, uint8_t percent )
+ * returns percent of value rounded to the nearest integer
+ */
+unsigned long MotionMathPercent( unsigned long value, uint8_t percent )
+{
+    // split value to keep the product inside 32 bits for large values
+    unsigned long quotient = value / 100;
+    unsigned long remainder = value % 100;
+
+    return quotient * percent + (remainder * percent + 50) / 100;
+}
+
+
+/*****************************************************
+ * MotionMathRatio16( unsigned int numerator, unsigned int denominator )
+ * returns numerator / denominator as 16.16 fixed point value
+ * the integer part must be below 65536
+ */
+ufixed16_t MotionMathRatio16( unsigned int numerator, unsigned int denominator )
+{
+    if ( denominator == 0 ) { return 0; }
+
+    return ((unsigned long)numerator << 16) / denominator;
+}
+
+
+/*****************************************************
+ * MotionMathLerp16( unsigned int from, unsigned int to, unsigned int fraction )
+ * interpolates linearly between from and to
+ * fraction is the 16 bit fractional part of a 16.16 value, 0 = from, 65535 ~ to
+ */
+unsigned int MotionMathLerp16( unsigned int from, unsigned int to, unsigned int fraction )
+{
+    if ( to >= from )
+    {
+        return from + (((unsigned long)(to - from) * fraction + 0x8000) >> 16);
+    }
+
+    return from - (((unsigned long)(from - to) * fraction + 0x8000) >> 16);
+}
+
+
+/*****************************************************
+ * MotionMathFraction16( unsigned long numerator, unsigned long denominator )
+ * returns numerator / denominator as 16 bit fraction, 65535 ~ 1.0
+ * numerator >= denominator returns 65535
+ * denominator must be below 2^31
+ */
+unsigned int MotionMathFraction16( unsigned long numerator, unsigned long denominator )
+{
+    if ( numerator >= denominator ) { return 0xFFFF; }
+
+    // bitwise long division, numerator << 16 would not fit into 32 bits
+    unsigned int fraction = 0;
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        numerator <<= 1;
+        fraction <<= 1;
+        if ( numerator >= denominator )
+        {
+            numerator -= denominator;
+            fraction |= 1;
+        }
+    }
+
+    return fraction;
+}
+
+
+/*****************************************************
+ * MotionMathSCurve16( unsigned int fraction )
+ * jerk limited speed curve from 0 to 65535 over fraction 0 to 65535
+ *
+ * The acceleration rises linearly in the first third, stays constant
+ * in the second third and falls linearly to zero in the last third:
+ *   first third:   9/4 u^2
+ *   second third:  1/4 + 3/2 (u - 1/3)
+ *   last third:    1 - 9/4 (1 - u)^2
+ */
+unsigned int MotionMathSCurve16( unsigned int fraction )
+{
+    const unsigned int oneThird = 21845;
+    const unsigned int twoThirds = 43690;
+
+    if ( fraction < oneThird )
+    {
+        unsigned long square = ((unsigned long)fraction * fraction) >> 16;
+        return (square * 9) / 4;
+    }
+
+    if ( fraction < twoThirds )
+    {
+        return 16384 + ((unsigned long)(fraction - oneThird) * 3) / 2;
+    }
+
+    unsigned int rest = 0xFFFF - fraction;
+    unsigned long square = ((unsigned long)rest * rest) >> 16;
+    return 0xFFFF - (square * 9) / 4;
+}
+
+
+/*****************************************************
+ * MotionMathTravelTime( unsigned long steps, unsigned long pulseDelay )
+ * returns the milliseconds steps take at a constant pulse delay
+ * in microseconds, rounded to the nearest millisecond
+ */
+unsigned long MotionMathTravelTime( unsigned long steps, unsigned long pulseDelay )
+{
+    // split steps to keep the product inside 32 bits for long moves at low speed
+    unsigned long quotient = steps / 1000;
+    unsigned long remainder = steps % 1000;
+
+    return quotient * pulseDelay + (remainder * pulseDelay + 500) / 1000;
+}
@@ -0,0 +1,192 @@
+#include "PositionJournal.h"
+#include "EepromWriter.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+struct PositionJournalRecord
+{
+    unsigned long sequence;     // counts the records ever written, 0xFFFFFFFF = never written
+    unsigned long position;     // the step position
+    byte crc;                   // CRC-8 of sequence and position
+    byte state;                 // POSITION_JOURNAL_REST, POSITION_JOURNAL_MOVING or 0
+    unsigned long target;       // the target of the move from position, valid with POSITION_JOURNAL_MOVING
+};
+
+#define POSITION_JOURNAL_CRC_LENGTH 8   // the bytes of a record the CRC covers
+
+/********** GLOBALS ******************************************************/
+static PositionJournalRecord JOURNAL_COPIES[2];             // the RAM copies of the records, used in turns
+static byte JOURNAL_NEWEST                      = 0;        // index into JOURNAL_COPIES of the newest record
+static byte JOURNAL_INDEX                       = POSITION_JOURNAL_RECORDS - 1; // the record in the ring the newest record is stored in
+static bool JOURNAL_VALID                       = false;    // true if there is a newest record
+/*************************************************************************/
+
+
+/*****************************************************
+ * PositionJournalCrc( const PositionJournalRecord &record )
+ * returns the CRC-8 of the sequence and the position
+ */
+static byte PositionJournalCrc( const PositionJournalRecord &record )
+{
+    const byte *data = (const byte *)&record;
+    byte crc = 0;
+
+    for (byte i = 0; i < POSITION_JOURNAL_CRC_LENGTH; i++) { crc = _crc8_ccitt_update( crc, data[i] ); }
+
+    return crc;
+}
+
+
+/*****************************************************
+ * PositionJournalAddress( byte index )
+ * returns the EEPROM address of a record in the ring
+ */
+static int PositionJournalAddress( byte index )
+{
+    return POSITION_JOURNAL_ADDRESS + index * sizeof(PositionJournalRecord);
+}
+
+
+/*****************************************************
+ * PositionJournalInit()
+ * Finds the newest valid record, call once at boot
+ */
+void PositionJournalInit()
+{
+    PositionJournalRecord &newest = JOURNAL_COPIES[JOURNAL_NEWEST];
+    JOURNAL_VALID = false;
+
+    for (byte i = 0; i < POSITION_JOURNAL_RECORDS; i++)
+    {
+        PositionJournalRecord record;
+        eeprom_read_block( &record, (const void *)PositionJournalAddress(i), sizeof(record) );
+
+        if ( record.sequence == 0xFFFFFFFF || record.crc != PositionJournalCrc( record ) ) { continue; }
+        if ( JOURNAL_VALID && record.sequence <= newest.sequence ) { continue; }
+
+        newest = record;
+        JOURNAL_INDEX = i;
+        JOURNAL_VALID = true;
+    }
+}
+
+
+/*****************************************************
+ * PositionJournalGetRestPosition( unsigned long *position )
+ * returns true if the motor has been at rest since the newest
+ * record has been written and stores its position
+ */
+bool PositionJournalGetRestPosition( unsigned long *position )
+{
+    const PositionJournalRecord &newest = JOURNAL_COPIES[JOURNAL_NEWEST];
+    if ( !JOURNAL_VALID || newest.state != POSITION_JOURNAL_REST ) { return false; }
+
+    *position = newest.position;
+    return true;
+}
+
+
+/*****************************************************
+ * PositionJournalGetLowestPosition( unsigned long *position )
+ * returns true if the journal knows how close to endstop A the
+ * motor can be and stores that position: the rest position, or
+ * the lower one of the rest position and the target of the move
+ * that started from there
+ */
+bool PositionJournalGetLowestPosition( unsigned long *position )
+{
+    const PositionJournalRecord &newest = JOURNAL_COPIES[JOURNAL_NEWEST];
+    if ( !JOURNAL_VALID ) { return false; }
+
+    if ( newest.state == POSITION_JOURNAL_REST )
+    {
+        *position = newest.position;
+        return true;
+    }
+
+    if ( newest.state == POSITION_JOURNAL_MOVING )
+    {
+        *position = min( newest.position, newest.target );
+        return true;
+    }
+
+    return false;
+}
+
+
+/*****************************************************
+ * PositionJournalSetRest( unsigned long position )
+ * Writes the position with the rest marker into the next record,
+ * nothing is written if it is stored already
+ */
+void PositionJournalSetRest( unsigned long position )
+{
+    const PositionJournalRecord &newest = JOURNAL_COPIES[JOURNAL_NEWEST];
+    if ( JOURNAL_VALID && newest.state == POSITION_JOURNAL_REST && newest.position == position ) { return; }
+
+    // the other copy, the newest one may still be in the queue of the EepromWriter
+    byte next = 1 - JOURNAL_NEWEST;
+    PositionJournalRecord &record = JOURNAL_COPIES[next];
+
+    record.sequence = JOURNAL_VALID ? newest.sequence + 1 : 0;
+    record.position = position;
+    record.crc = PositionJournalCrc( record );
+    record.state = POSITION_JOURNAL_REST;
+    record.target = position;
+
+    JOURNAL_NEWEST = next;
+    JOURNAL_INDEX = (JOURNAL_INDEX + 1) % POSITION_JOURNAL_RECORDS;
+    JOURNAL_VALID = true;
+
+    EepromWriterSchedule( PositionJournalAddress(JOURNAL_INDEX), &record, sizeof(record) );
+}
+
+
+/*****************************************************
+ * PositionJournalWriteState( byte state )
+ * Writes the state of the newest record right away
+ */
+static void PositionJournalWriteState( byte state )
+{
+    PositionJournalRecord &newest = JOURNAL_COPIES[JOURNAL_NEWEST];
+
+    newest.state = state;
+    eeprom_update_byte( (uint8_t *)(PositionJournalAddress(JOURNAL_INDEX) + offsetof(PositionJournalRecord, state)), newest.state );
+}
+
+
+/*****************************************************
+ * PositionJournalSetMoving( unsigned long target )
+ * Replaces the rest marker of the newest record by the moving
+ * marker and the target, call it before the motor moves. While
+ * the motor is moving a target closer to endstop A than the stored
+ * one clears the marker, the motor may be anywhere from then on
+ * until it rests again.
+ *
+ * The bytes are written right away and not queued, the marker must
+ * be gone before the first step. Leaving the rest marker blocks for up
+ * to 5 bytes of 3.3 ms each, clearing the moving marker for 1 byte.
+ * Bytes that do not change are skipped, and nothing is written again
+ * until the next rest. If the record itself is still queued, the
+ * EepromWriter writes the new values from the RAM copy as well.
+ */
+void PositionJournalSetMoving( unsigned long target )
+{
+    PositionJournalRecord &newest = JOURNAL_COPIES[JOURNAL_NEWEST];
+    if ( !JOURNAL_VALID ) { return; }
+
+    if ( newest.state == POSITION_JOURNAL_MOVING )
+    {
+        if ( target < newest.target ) { PositionJournalWriteState( 0 ); }
+        return;
+    }
+
+    if ( newest.state != POSITION_JOURNAL_REST ) { return; }
+
+    // the target goes first, the rest marker stays valid while it is
+    // written as the motor has not moved yet
+    newest.target = target;
+    eeprom_update_block( &newest.target, (void *)(PositionJournalAddress(JOURNAL_INDEX) + offsetof(PositionJournalRecord, target)), sizeof(newest.target) );
+
+    PositionJournalWriteState( POSITION_JOURNAL_MOVING );
+}
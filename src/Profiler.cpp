@@ -0,0 +1,71 @@
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <util/atomic.h>
+
+/********** GLOBALS ******************************************************/
+static volatile ProfilerStats PROFILER_STATS[PROFILER_PROBES];     // the statistics of every probe
+/*************************************************************************/
+
+
+/*****************************************************
+ * ProfilerInit()
+ * Starts Timer5 as a free running counter and clears the table
+ */
+void ProfilerInit()
+{
+    // normal mode, prescaler 8, the same setup as the jitter measurement
+    TCCR5A = 0;
+    TCCR5C = 0;
+    TIMSK5 = 0;
+    TCCR5B = _BV(CS51);
+
+    ProfilerReset();
+}
+
+
+/*****************************************************
+ * ProfilerReset()
+ * Clears the statistics of all probes
+ */
+void ProfilerReset()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset( (void *)PROFILER_STATS, 0, sizeof(PROFILER_STATS) );
+    }
+}
+
+
+/*****************************************************
+ * ProfilerGet( byte probe, ProfilerStats *stats )
+ * Copies the statistics of a probe
+ */
+void ProfilerGet( byte probe, ProfilerStats *stats )
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy( stats, (const void *)&PROFILER_STATS[probe], sizeof(ProfilerStats) );
+    }
+}
+
+
+/*****************************************************
+ * ProfilerAdd( byte probe, uint16_t ticks )
+ * Adds a measurement to a probe, called by ProfilerScope
+ */
+void ProfilerAdd( byte probe, uint16_t ticks )
+{
+    // every probe is only used in one context, the main loop or one interrupt,
+    // so no interrupt has to wait here, only ProfilerGet() needs to be atomic
+    volatile ProfilerStats &stats = PROFILER_STATS[probe];
+    if ( stats.count == 0xFFFFFFFF ) { return; }
+
+    if ( stats.count == 0 || ticks < stats.min ) { stats.min = ticks; }
+    if ( ticks > stats.max ) { stats.max = ticks; }
+    stats.total += ticks;
+    stats.count++;
+}
+
+#endif // PROFILER_ENABLED
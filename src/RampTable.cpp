@@ -0,0 +1,133 @@
+#include "RampTable.h"
+#include "MotionMath.h"
+
+/********** GLOBALS ******************************************************/
+static uint16_t RAMP_TABLE[RAMP_TABLE_SIZE];                // the pulse delays of the ramp in microseconds
+static unsigned int RAMP_ACCEL_STEPS            = 0;        // number of ramp steps the table covers
+static ufixed16_t RAMP_INDEX_SCALE              = 0;        // factor from ramp step to table index
+/*************************************************************************/
+
+
+/*****************************************************
+ * RampSCurveDelay( unsigned int startDelay, unsigned int endDelay, unsigned int fraction )
+ * returns the pulse delay of the S-curve at fraction of the ramp time
+ *
+ * the speed follows the S-curve, the pulse delay is its reciprocal:
+ * delay = startDelay * endDelay / (endDelay + (startDelay - endDelay) * s)
+ */
+static unsigned int RampSCurveDelay( unsigned int startDelay, unsigned int endDelay, unsigned int fraction )
+{
+    unsigned int s = MotionMathSCurve16( fraction );
+    unsigned long divisor = endDelay + (((unsigned long)(startDelay - endDelay) * s) >> 16);
+
+    return ((unsigned long)startDelay * endDelay + divisor / 2) / divisor;
+}
+
+
+/*****************************************************
+ * RampTableBuild( unsigned int startDelay, unsigned int endDelay, unsigned int accelSteps, byte profile )
+ * Fills the table with the ramp of the pulse delay
+ *
+ * startDelay: the pulse delay at standstill
+ * endDelay: the pulse delay at full speed
+ * accelSteps: the number of steps from standstill to full speed
+ * profile: RAMP_PROFILE_LINEAR or RAMP_PROFILE_SCURVE
+ */
+void RampTableBuild( unsigned int startDelay, unsigned int endDelay, unsigned int accelSteps, byte profile )
+{
+    RAMP_ACCEL_STEPS = accelSteps;
+
+    // without acceleration steps the motor starts with full speed
+    if ( accelSteps == 0 || startDelay <= endDelay )
+    {
+        RAMP_ACCEL_STEPS = 0;
+        RAMP_INDEX_SCALE = 0;
+        for (size_t i = 0; i < RAMP_TABLE_SIZE; i++) { RAMP_TABLE[i] = endDelay; }
+        return;
+    }
+
+    RAMP_INDEX_SCALE = MotionMathRatio16( RAMP_TABLE_SIZE - 1, accelSteps );
+
+    if ( profile != RAMP_PROFILE_SCURVE )
+    {
+        for (size_t i = 0; i < RAMP_TABLE_SIZE; i++)
+        {
+            RAMP_TABLE[i] = MotionMathLinearMap( i, 0, RAMP_TABLE_SIZE - 1, startDelay, endDelay );
+        }
+        return;
+    }
+
+    // The S-curve is a function of time, so we step through the ramp like the
+    // motor would: every step advances the time by its own pulse delay.
+    // The ramp time is chosen so that the ramp covers accelSteps steps,
+    // because the curve is point symmetric the mean speed is (v0 + vmax) / 2.
+    unsigned long rampTime = 2UL * accelSteps * ((unsigned long)startDelay * endDelay / (startDelay + endDelay));
+    unsigned long elapsedTime = 0;
+    unsigned int step = 0;
+    unsigned int pulseDelay = startDelay;
+
+    for (size_t i = 0; i < RAMP_TABLE_SIZE; i++)
+    {
+        unsigned int tableStep = MotionMathLinearMap( i, 0, RAMP_TABLE_SIZE - 1, 0, accelSteps );
+
+        while ( step < tableStep )
+        {
+            elapsedTime += pulseDelay;
+            step++;
+            pulseDelay = RampSCurveDelay( startDelay, endDelay, MotionMathFraction16(elapsedTime, rampTime) );
+        }
+
+        RAMP_TABLE[i] = pulseDelay;
+    }
+
+    RAMP_TABLE[RAMP_TABLE_SIZE - 1] = endDelay;
+}
+
+
+/*****************************************************
+ * RampTableLookup( unsigned int rampStep )
+ * returns the pulse delay for a step of the ramp
+ * 0 is standstill, RampTableGetAccelSteps() and above is full speed
+ */
+unsigned int RampTableLookup( unsigned int rampStep )
+{
+    if ( rampStep >= RAMP_ACCEL_STEPS ) { return RAMP_TABLE[RAMP_TABLE_SIZE - 1]; }
+
+    ufixed16_t index = rampStep * RAMP_INDEX_SCALE;
+    uint8_t i = index >> 16;
+
+    // interpolate between the two neighbouring table entries
+    return MotionMathLerp16( RAMP_TABLE[i], RAMP_TABLE[i + 1], index & 0xFFFF );
+}
+
+
+/*****************************************************
+ * RampTableFindStep( unsigned long pulseDelay )
+ * returns the first ramp step that is at least as fast as pulseDelay
+ * this is where a move with a cruise speed below full speed stops accelerating
+ */
+unsigned int RampTableFindStep( unsigned long pulseDelay )
+{
+    unsigned int lowStep = 0;
+    unsigned int highStep = RAMP_ACCEL_STEPS;
+
+    // the delays are falling with the ramp step
+    while ( lowStep < highStep )
+    {
+        unsigned int middleStep = lowStep + (highStep - lowStep) / 2;
+        if ( RampTableLookup(middleStep) <= pulseDelay ) { highStep = middleStep; }
+        else { lowStep = middleStep + 1; }
+    }
+
+    return lowStep;
+}
+
+
+/*****************************************************
+ * RampTableGetAccelSteps()
+ * returns the number of steps from standstill to full speed
+ */
+unsigned int RampTableGetAccelSteps()
+{
+    return RAMP_ACCEL_STEPS;
+}
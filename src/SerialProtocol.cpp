@@ -0,0 +1,253 @@
+#include "SerialProtocol.h"
+#include "Log.h"
+#include "Profiler.h"
+#include <util/crc16.h>
+
+// where the parser is within the current frame
+enum SerialProtocolParserState
+{
+    PARSER_START,
+    PARSER_LENGTH,
+    PARSER_COMMAND,
+    PARSER_SEQUENCE,
+    PARSER_PAYLOAD,
+    PARSER_CRC
+};
+
+/********** GLOBALS ******************************************************/
+static SerialProtocolHandler PROTOCOL_HANDLER   = NULL;     // called for every received frame
+static SerialProtocolParserState PARSER_STATE   = PARSER_START; // the next expected byte
+static byte FRAME_LENGTH                        = 0;        // payload length of the current frame
+static byte FRAME_COMMAND                       = 0;        // command of the current frame
+static byte FRAME_SEQUENCE                      = 0;        // sequence number of the current frame
+static byte FRAME_PAYLOAD[SERIAL_PROTOCOL_MAX_PAYLOAD];     // payload of the current frame
+static byte FRAME_RECEIVED                      = 0;        // payload bytes received so far
+static byte FRAME_CRC                           = 0;        // CRC over the bytes received so far
+static unsigned long FRAME_TIME                 = 0;        // millis() of the last received byte
+
+static byte TX_BUFFER[SERIAL_PROTOCOL_TX_SIZE];             // ring buffer of the frames waiting for the UART
+static byte TX_HEAD                             = 0;        // buffer index of the next frame
+static byte TX_COUNT                            = 0;        // bytes waiting in the buffer
+static unsigned int TX_DROPPED                  = 0;        // replies dropped since the last report
+static unsigned long TX_DROPPED_TOTAL           = 0;        // replies dropped since the start
+/*************************************************************************/
+
+
+/*****************************************************
+ * SerialProtocolParse( byte value )
+ * Feeds one received byte into the parser
+ */
+static void SerialProtocolParse( byte value )
+{
+    switch ( PARSER_STATE )
+    {
+        case PARSER_START:
+            // everything between frames is ignored
+            if ( value == SERIAL_PROTOCOL_START )
+            {
+                FRAME_CRC = 0;
+                PARSER_STATE = PARSER_LENGTH;
+            }
+            return;
+
+        case PARSER_LENGTH:
+            // a length that is too large can only be a broken frame, wait for the next one
+            if ( value > SERIAL_PROTOCOL_MAX_PAYLOAD )
+            {
+                PARSER_STATE = PARSER_START;
+                return;
+            }
+            FRAME_LENGTH = value;
+            PARSER_STATE = PARSER_COMMAND;
+            break;
+
+        case PARSER_COMMAND:
+            FRAME_COMMAND = value;
+            PARSER_STATE = PARSER_SEQUENCE;
+            break;
+
+        case PARSER_SEQUENCE:
+            FRAME_SEQUENCE = value;
+            FRAME_RECEIVED = 0;
+            PARSER_STATE = FRAME_LENGTH > 0 ? PARSER_PAYLOAD : PARSER_CRC;
+            break;
+
+        case PARSER_PAYLOAD:
+            FRAME_PAYLOAD[FRAME_RECEIVED++] = value;
+            if ( FRAME_RECEIVED >= FRAME_LENGTH ) { PARSER_STATE = PARSER_CRC; }
+            break;
+
+        case PARSER_CRC:
+            PARSER_STATE = PARSER_START;
+
+            if ( value != FRAME_CRC )
+            {
+                SerialProtocolReply( FRAME_COMMAND, FRAME_SEQUENCE, SERIAL_PROTOCOL_STATUS_BAD_CRC );
+                return;
+            }
+
+            if ( PROTOCOL_HANDLER != NULL )
+            {
+                PROTOCOL_HANDLER( FRAME_COMMAND, FRAME_SEQUENCE, FRAME_PAYLOAD, FRAME_LENGTH );
+            }
+            return;
+    }
+
+    FRAME_CRC = _crc8_ccitt_update( FRAME_CRC, value );
+}
+
+
+/*****************************************************
+ * SerialProtocolFlush()
+ * Hands the waiting frames to the UART, but only whole
+ * frames that fit into its TX buffer without waiting
+ */
+static void SerialProtocolFlush()
+{
+    while ( TX_COUNT > 0 )
+    {
+        byte frameLength = TX_BUFFER[(TX_HEAD + 1) % SERIAL_PROTOCOL_TX_SIZE] + SERIAL_PROTOCOL_OVERHEAD;
+        if ( Serial.availableForWrite() < frameLength ) { return; }
+
+        for (byte i = 0; i < frameLength; i++)
+        {
+            Serial.write( TX_BUFFER[TX_HEAD] );
+            TX_HEAD = (TX_HEAD + 1) % SERIAL_PROTOCOL_TX_SIZE;
+        }
+        TX_COUNT -= frameLength;
+    }
+}
+
+
+/*****************************************************
+ * SerialProtocolInit( SerialProtocolHandler handler )
+ * Opens the serial port
+ *
+ * handler: called for every received frame
+ */
+void SerialProtocolInit( SerialProtocolHandler handler )
+{
+    PROTOCOL_HANDLER = handler;
+    Serial.begin(SERIAL_PROTOCOL_BAUD);
+}
+
+
+/*****************************************************
+ * SerialProtocolTask()
+ * Call once per loop, parses the received bytes and
+ * sends the waiting frames
+ */
+void SerialProtocolTask()
+{
+    PROFILE(PROFILER_SERIAL);
+
+    // drop a frame that has stopped halfway, the next one starts clean
+    if ( PARSER_STATE != PARSER_START && millis() - FRAME_TIME >= SERIAL_PROTOCOL_TIMEOUT )
+    {
+        PARSER_STATE = PARSER_START;
+    }
+
+    // only the bytes that are already there, read() never waits
+    int available = Serial.available();
+    if ( available > 0 ) { FRAME_TIME = millis(); }
+
+    while ( available-- > 0 )
+    {
+        SerialProtocolParse( Serial.read() );
+    }
+
+    SerialProtocolFlush();
+
+    // the host has waited in vain for these replies
+    if ( TX_DROPPED > 0 )
+    {
+        unsigned int dropped = TX_DROPPED;
+        TX_DROPPED = 0;
+        LOG_WARN("%u replies dropped", dropped);
+    }
+}
+
+
+/*****************************************************
+ * SerialProtocolSend( byte command, byte sequence, const void *payload, byte length )
+ * Queues a frame to be sent
+ * returns false if it does not fit into the queue
+ *
+ * command: the command or notification code
+ * sequence: the sequence number of the request or 0
+ * payload: length bytes, copied right away
+ */
+bool SerialProtocolSend( byte command, byte sequence, const void *payload, byte length )
+{
+    if ( length > SERIAL_PROTOCOL_MAX_PAYLOAD ) { return false; }
+    if ( length + SERIAL_PROTOCOL_OVERHEAD > SERIAL_PROTOCOL_TX_SIZE - TX_COUNT ) { return false; }
+
+    byte header[4] = { SERIAL_PROTOCOL_START, length, command, sequence };
+    byte index = (TX_HEAD + TX_COUNT) % SERIAL_PROTOCOL_TX_SIZE;
+    byte crc = 0;
+
+    for (byte i = 0; i < sizeof(header); i++)
+    {
+        TX_BUFFER[index] = header[i];
+        index = (index + 1) % SERIAL_PROTOCOL_TX_SIZE;
+        if ( i > 0 ) { crc = _crc8_ccitt_update( crc, header[i] ); }
+    }
+
+    for (byte i = 0; i < length; i++)
+    {
+        byte value = ((const byte *)payload)[i];
+        TX_BUFFER[index] = value;
+        index = (index + 1) % SERIAL_PROTOCOL_TX_SIZE;
+        crc = _crc8_ccitt_update( crc, value );
+    }
+
+    TX_BUFFER[index] = crc;
+    TX_COUNT += length + SERIAL_PROTOCOL_OVERHEAD;
+
+    return true;
+}
+
+
+/*****************************************************
+ * SerialProtocolReply( byte command, byte sequence, byte status, const void *data, byte length )
+ * Queues the reply to a command
+ *
+ * command: the command that is answered
+ * sequence: the sequence number of the command
+ * status: one of the SERIAL_PROTOCOL_STATUS values
+ * data: length bytes that follow the status byte
+ *
+ * A reply that does not fit into the queue is dropped and counted,
+ * SerialProtocolTask() logs the number of dropped replies.
+ */
+bool SerialProtocolReply( byte command, byte sequence, byte status, const void *data, byte length )
+{
+    byte payload[SERIAL_PROTOCOL_MAX_PAYLOAD];
+    bool queued = false;
+
+    if ( length < SERIAL_PROTOCOL_MAX_PAYLOAD )
+    {
+        payload[0] = status;
+        if ( length > 0 ) { memcpy( payload + 1, data, length ); }
+
+        queued = SerialProtocolSend( command | SERIAL_PROTOCOL_REPLY, sequence, payload, length + 1 );
+    }
+
+    if ( !queued )
+    {
+        TX_DROPPED++;
+        TX_DROPPED_TOTAL++;
+    }
+
+    return queued;
+}
+
+
+/*****************************************************
+ * SerialProtocolGetDroppedCount()
+ * returns the number of replies dropped since the start
+ */
+unsigned long SerialProtocolGetDroppedCount()
+{
+    return TX_DROPPED_TOTAL;
+}
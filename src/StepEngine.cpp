@@ -0,0 +1,654 @@
+#include "StepEngine.h"
+#include "RampTable.h"
+#include "Profiler.h"
+#include <util/atomic.h>
+
+#define STEP_ENGINE_TICKS_PER_US    2       // Timer3 runs with prescaler 8 = 0.5 microseconds per tick
+#define STEP_ENGINE_CHUNK_TICKS     0x8000  // intervals longer than 16 bit are waited in chunks of this size
+#define STEP_ENGINE_PULSE_TICKS     (STEP_ENGINE_PULSE_WIDTH * STEP_ENGINE_TICKS_PER_US)
+
+/********** GLOBALS ******************************************************/
+static volatile uint8_t *PUL_PORT               = 0;        // output register of the PUL pin
+static uint8_t PUL_MASK                         = 0;        // bit mask of the PUL pin
+static volatile uint8_t *DIR_PORT               = 0;        // output register of the DIR pin
+static uint8_t DIR_MASK                         = 0;        // bit mask of the DIR pin
+static volatile uint8_t *END_STOP_A_PORT        = 0;        // input register of endstop A
+static uint8_t END_STOP_A_MASK                  = 0;        // bit mask of endstop A
+static volatile uint8_t *END_STOP_B_PORT        = 0;        // input register of endstop B
+static uint8_t END_STOP_B_MASK                  = 0;        // bit mask of endstop B
+
+static volatile bool STEP_ENGINE_RUNNING                = false;    // true as long as the engine emits steps
+static volatile bool STEP_ENGINE_DIRECTION              = LOW;      // LOW = clockwise rotation = position increases
+static volatile unsigned long STEP_ENGINE_POSITION      = 0;        // the current position of the motor in steps
+static volatile unsigned long STEP_ENGINE_STEPS         = 0;        // number of steps to do or STEP_ENGINE_CONTINUOUS
+static volatile unsigned long STEP_ENGINE_STEPS_DONE    = 0;        // number of steps done since StepEngineStart()
+static volatile unsigned long STEP_ENGINE_NEXT_TICKS    = 0;        // precomputed interval in ticks loaded after the next pulse
+static volatile unsigned long STEP_ENGINE_PENDING_TICKS = 0;        // rest of a long interval that still has to be waited
+
+static volatile bool STEP_ENGINE_PROFILED               = false;    // true if the pulse delays come from the RampTable
+static volatile unsigned int STEP_ENGINE_RAMP_STEP      = 0;        // the current step on the ramp, 0 is standstill
+static volatile unsigned int STEP_ENGINE_RAMP_MAX       = 0;        // the ramp step where the cruise speed is reached
+static volatile unsigned long STEP_ENGINE_CRUISE_INTERVAL = 0;      // the pulse delay at cruise speed
+
+static volatile uint8_t STEP_ENGINE_END_STOP_EVENTS     = 0;        // the endstops that stopped the engine, STEP_ENGINE_ENDSTOP_A | STEP_ENGINE_ENDSTOP_B
+static volatile unsigned long STEP_ENGINE_END_STOP_POSITION = 0;    // the position where the last endstop stopped the engine
+
+static volatile unsigned long STEP_ENGINE_EDGE_TICKS    = 0;        // the interval in ticks between the last and the next rising edge
+static volatile uint16_t STEP_ENGINE_EDGE_TIME          = 0;        // Timer5 at the last rising edge
+static volatile StepEngineJitter STEP_ENGINE_JITTER;                // the jitter measurement, only while STEP_ENGINE_JITTER.enabled
+/*************************************************************************/
+
+
+/*****************************************************
+ * StepEngineLoadTicks( unsigned long ticks )
+ * Loads the next timer period. Intervals that do not fit
+ * into the 16 bit compare register are split into chunks.
+ * Must be called with interrupts disabled.
+ */
+static inline void StepEngineLoadTicks( unsigned long ticks )
+{
+    if ( ticks > 0xFFFF )
+    {
+        OCR3A = STEP_ENGINE_CHUNK_TICKS - 1;
+        STEP_ENGINE_PENDING_TICKS = ticks - STEP_ENGINE_CHUNK_TICKS;
+    }
+    else
+    {
+        OCR3A = ticks - 1;
+        STEP_ENGINE_PENDING_TICKS = 0;
+    }
+
+    // if we are late (another interrupt delayed us) the counter may already
+    // be past the new compare value, fire as soon as possible instead of
+    // waiting for a full 16 bit wrap around
+    if ( TCNT3 >= OCR3A ) { TCNT3 = OCR3A - 1; }
+}
+
+
+/*****************************************************
+ * StepEngineMeasureJitter()
+ * Compares the time since the last rising edge with the interval
+ * that has been loaded for it. Must be called by the interrupt
+ * right after PUL has been raised.
+ */
+static inline void StepEngineMeasureJitter()
+{
+    uint16_t now = TCNT5;
+    uint16_t elapsed = now - STEP_ENGINE_EDGE_TIME;
+    STEP_ENGINE_EDGE_TIME = now;
+
+    // the first step of a move has no edge before it
+    if ( STEP_ENGINE_STEPS_DONE == 0 || STEP_ENGINE_EDGE_TICKS > 0xFFFF ) { return; }
+
+    int deviation = (int)(elapsed - (uint16_t)STEP_ENGINE_EDGE_TICKS);
+    unsigned int magnitude = ( deviation < 0 ? -deviation : deviation ) / STEP_ENGINE_TICKS_PER_US;
+
+    uint8_t bin = 0;
+    while ( bin < STEP_ENGINE_JITTER_BINS - 1 && magnitude >= (1U << bin) ) { bin++; }
+
+    volatile StepEngineJitter &jitter = STEP_ENGINE_JITTER;
+    if ( jitter.bins[bin] < 0xFFFF ) { jitter.bins[bin]++; }
+    jitter.steps++;
+
+    if ( jitter.moveSteps == 0 || deviation < jitter.moveMin ) { jitter.moveMin = deviation; }
+    if ( jitter.moveSteps == 0 || deviation > jitter.moveMax ) { jitter.moveMax = deviation; }
+    if ( jitter.moveSteps < 0xFFFF )
+    {
+        jitter.moveSteps++;
+        jitter.moveSum += deviation;
+    }
+}
+
+
+/*****************************************************
+ * StepEngineKeepPulse( uint16_t pulseEnd )
+ * Moves the top of the timer behind pulseEnd, so compare match B
+ * is reached before the counter starts again and PUL stays low for
+ * the pulse width before the next pulse. Only a late pulse makes
+ * the interval longer. Must be called with interrupts disabled.
+ */
+static inline void StepEngineKeepPulse( uint16_t pulseEnd )
+{
+    uint16_t minTop = pulseEnd + STEP_ENGINE_PULSE_TICKS;
+    if ( OCR3A < minTop ) { OCR3A = minTop; }
+}
+
+
+/*****************************************************
+ * StepEngineClosedEndStop()
+ * returns the endstop in the current direction if its switch is
+ * closed (LOW), otherwise STEP_ENGINE_ENDSTOP_NONE
+ * Moving away from a closed endstop is always possible.
+ */
+static inline uint8_t StepEngineClosedEndStop()
+{
+    if ( STEP_ENGINE_DIRECTION == HIGH )
+    {
+        if ( END_STOP_A_PORT && ( *END_STOP_A_PORT & END_STOP_A_MASK ) == 0 ) { return STEP_ENGINE_ENDSTOP_A; }
+    }
+    else
+    {
+        if ( END_STOP_B_PORT && ( *END_STOP_B_PORT & END_STOP_B_MASK ) == 0 ) { return STEP_ENGINE_ENDSTOP_B; }
+    }
+
+    return STEP_ENGINE_ENDSTOP_NONE;
+}
+
+
+/*****************************************************
+ * StepEngineNextRampInterval()
+ * Decides if the next step accelerates, cruises or decelerates
+ * and returns its pulse delay from the RampTable.
+ * Must be called with interrupts disabled after a step.
+ *
+ * Accelerating is only allowed as long as there are enough steps left
+ * to brake from the higher speed again. That way short moves get a
+ * symmetric ramp that turns at the speed actually reached.
+ * A lower cruise speed set during the move is reached along the ramp, too.
+ */
+static inline unsigned long StepEngineNextRampInterval()
+{
+    PROFILE(PROFILER_RAMP);
+
+    unsigned long stepsLeft = 0xFFFFFFFF;
+    if ( STEP_ENGINE_STEPS != STEP_ENGINE_CONTINUOUS ) { stepsLeft = STEP_ENGINE_STEPS - STEP_ENGINE_STEPS_DONE; }
+
+    unsigned int rampStep = STEP_ENGINE_RAMP_STEP;
+    unsigned long interval;
+
+    // DECELERATION
+    if ( stepsLeft <= rampStep )
+    {
+        rampStep--;
+        interval = RampTableLookup(rampStep);
+    }
+
+    // SLOW DOWN TO A NEW CRUISE SPEED
+    else if ( rampStep > STEP_ENGINE_RAMP_MAX )
+    {
+        rampStep--;
+        interval = RampTableLookup(rampStep);
+    }
+
+    // ACCELERATION
+    else if ( rampStep < STEP_ENGINE_RAMP_MAX && stepsLeft >= (unsigned long)rampStep + 2 )
+    {
+        interval = RampTableLookup(rampStep);
+        rampStep++;
+    }
+
+    // CRUISE
+    else
+    {
+        interval = RampTableLookup(rampStep);
+    }
+
+    STEP_ENGINE_RAMP_STEP = rampStep;
+
+    // above the cruise ramp step the engine is still slowing down to the new cruise speed
+    if ( rampStep <= STEP_ENGINE_RAMP_MAX && interval < STEP_ENGINE_CRUISE_INTERVAL ) { interval = STEP_ENGINE_CRUISE_INTERVAL; }
+    return interval;
+}
+
+
+/*****************************************************
+ * StepEngineInit( uint8_t pulPin, uint8_t dirPin )
+ * Sets up the driver pins. The timer is only
+ * running while the engine emits steps.
+ */
+void StepEngineInit( uint8_t pulPin, uint8_t dirPin )
+{
+    pinMode(pulPin, OUTPUT);
+    pinMode(dirPin, OUTPUT);
+    digitalWrite(pulPin, LOW);
+    digitalWrite(dirPin, STEP_ENGINE_DIRECTION);
+
+    PUL_PORT = portOutputRegister( digitalPinToPort(pulPin) );
+    PUL_MASK = digitalPinToBitMask(pulPin);
+    DIR_PORT = portOutputRegister( digitalPinToPort(dirPin) );
+    DIR_MASK = digitalPinToBitMask(dirPin);
+
+    TCCR3A = 0;
+    TCCR3B = 0;
+    TIMSK3 = 0;
+}
+
+
+/*****************************************************
+ * StepEngineSetEndStops( uint8_t pinA, uint8_t pinB )
+ * Sets up the endstop switches, both close to GND
+ *
+ * pinA: the endstop at position 0, it blocks the HIGH direction
+ * pinB: the endstop at the other end, it blocks the LOW direction
+ */
+void StepEngineSetEndStops( uint8_t pinA, uint8_t pinB )
+{
+    pinMode(pinA, INPUT_PULLUP);
+    pinMode(pinB, INPUT_PULLUP);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        END_STOP_A_PORT = portInputRegister( digitalPinToPort(pinA) );
+        END_STOP_A_MASK = digitalPinToBitMask(pinA);
+        END_STOP_B_PORT = portInputRegister( digitalPinToPort(pinB) );
+        END_STOP_B_MASK = digitalPinToBitMask(pinB);
+    }
+}
+
+
+/*****************************************************
+ * StepEngineStart( unsigned long steps, unsigned long interval )
+ * Starts emitting steps in the current direction
+ *
+ * steps: the number of steps to do, STEP_ENGINE_CONTINUOUS steps until StepEngineStop()
+ * interval: the pulse delay in microseconds after the first step
+ */
+void StepEngineStart( unsigned long steps, unsigned long interval )
+{
+    StepEngineStop();
+    StepEngineSetInterval( interval );
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        STEP_ENGINE_PROFILED = false;
+        STEP_ENGINE_STEPS = steps;
+        STEP_ENGINE_STEPS_DONE = 0;
+        STEP_ENGINE_PENDING_TICKS = 0;
+        STEP_ENGINE_END_STOP_EVENTS = 0;
+        STEP_ENGINE_RUNNING = true;
+        STEP_ENGINE_JITTER.moveSteps = 0;
+        STEP_ENGINE_JITTER.moveSum = 0;
+
+        // CTC mode with OCR3A as top, prescaler 8
+        // the first pulse comes after STEP_ENGINE_MIN_INTERVAL to give DIR some setup time
+        TCNT3 = 0;
+        OCR3A = STEP_ENGINE_MIN_INTERVAL * STEP_ENGINE_TICKS_PER_US - 1;
+        OCR3B = STEP_ENGINE_PULSE_TICKS;
+        TIFR3 = _BV(OCF3A) | _BV(OCF3B);
+        TIMSK3 = _BV(OCIE3A) | _BV(OCIE3B);
+        TCCR3B = _BV(WGM32) | _BV(CS31);
+    }
+}
+
+
+/*****************************************************
+ * StepEngineStartProfile( unsigned long steps, unsigned long cruiseInterval )
+ * Starts a move in the current direction that accelerates and
+ * decelerates along the RampTable
+ *
+ * steps: the number of steps to do, STEP_ENGINE_CONTINUOUS accelerates and
+ *        cruises until StepEngineStop()
+ * cruiseInterval: the pulse delay in microseconds at cruise speed, it is never
+ *        faster than the end of the RampTable
+ */
+void StepEngineStartProfile( unsigned long steps, unsigned long cruiseInterval )
+{
+    if ( cruiseInterval < STEP_ENGINE_MIN_INTERVAL ) { cruiseInterval = STEP_ENGINE_MIN_INTERVAL; }
+
+    // search the ramp before starting, the interrupt only counts up to it
+    unsigned int rampMax = RampTableFindStep( cruiseInterval );
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        StepEngineStart( steps, cruiseInterval );
+        STEP_ENGINE_PROFILED = true;
+        STEP_ENGINE_RAMP_STEP = 0;
+        STEP_ENGINE_RAMP_MAX = rampMax;
+        STEP_ENGINE_CRUISE_INTERVAL = cruiseInterval;
+    }
+}
+
+
+/*****************************************************
+ * StepEngineSetCruiseInterval( unsigned long cruiseInterval )
+ * Changes the cruise speed of the running profiled move, the engine
+ * accelerates or decelerates along the RampTable to the new speed
+ */
+void StepEngineSetCruiseInterval( unsigned long cruiseInterval )
+{
+    if ( cruiseInterval < STEP_ENGINE_MIN_INTERVAL ) { cruiseInterval = STEP_ENGINE_MIN_INTERVAL; }
+
+    unsigned int rampMax = RampTableFindStep( cruiseInterval );
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        STEP_ENGINE_RAMP_MAX = rampMax;
+        STEP_ENGINE_CRUISE_INTERVAL = cruiseInterval;
+    }
+}
+
+
+/*****************************************************
+ * StepEngineSetTarget( unsigned long targetPosition )
+ * Moves the end of the running profiled move to targetPosition
+ *
+ * returns true if the target lies ahead in the current direction and the
+ * ramp has enough steps left to brake in time, the move then accelerates
+ * again or decelerates earlier as needed.
+ * Otherwise the move decelerates along the ramp as fast as possible and
+ * false is returned, the caller starts a new move to the target as soon
+ * as the engine has stopped.
+ */
+bool StepEngineSetTarget( unsigned long targetPosition )
+{
+    bool reachable = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ( STEP_ENGINE_RUNNING == false || STEP_ENGINE_PROFILED == false ) { return false; }
+
+        unsigned long position = STEP_ENGINE_POSITION;
+        unsigned long brakeSteps = STEP_ENGINE_RAMP_STEP;
+        unsigned long distance;
+        bool ahead;
+
+        if ( STEP_ENGINE_DIRECTION == LOW )
+        {
+            ahead = targetPosition >= position;
+            distance = targetPosition - position;
+        }
+        else
+        {
+            ahead = targetPosition <= position;
+            distance = position - targetPosition;
+        }
+
+        reachable = ahead && distance >= brakeSteps;
+        if ( reachable == false ) { distance = brakeSteps; }
+
+        // the interrupt always does one more step, so stop right here if no step is left
+        if ( distance == 0 ) { StepEngineStop(); }
+        else { STEP_ENGINE_STEPS = STEP_ENGINE_STEPS_DONE + distance; }
+    }
+
+    return reachable;
+}
+
+
+/*****************************************************
+ * StepEngineStop()
+ * Stops the motor immediately, a pulse that is high
+ * still gets its full width, at most STEP_ENGINE_PULSE_WIDTH
+ */
+void StepEngineStop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // the step of a pulse that is high has been counted already, cutting
+        // it short could make the driver miss it, compare match B ends it
+        // before the top of the timer, see StepEngineKeepPulse()
+        if ( PUL_PORT && ( *PUL_PORT & PUL_MASK ) && TCCR3B != 0 )
+        {
+            while ( TCNT3 < OCR3B ) {}
+        }
+
+        TCCR3B = 0;
+        TIMSK3 = 0;
+        STEP_ENGINE_RUNNING = false;
+        STEP_ENGINE_PENDING_TICKS = 0;
+        if ( PUL_PORT ) { *PUL_PORT &= ~PUL_MASK; }
+    }
+}
+
+
+/*****************************************************
+ * StepEngineSetInterval( unsigned long interval )
+ * Sets the pulse delay in microseconds the engine
+ * uses after the next step
+ */
+void StepEngineSetInterval( unsigned long interval )
+{
+    if ( interval < STEP_ENGINE_MIN_INTERVAL ) { interval = STEP_ENGINE_MIN_INTERVAL; }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        STEP_ENGINE_NEXT_TICKS = interval * STEP_ENGINE_TICKS_PER_US;
+    }
+}
+
+
+/*****************************************************
+ * StepEngineGetInterval()
+ * returns the pulse delay in microseconds the engine uses
+ * after the next step, 0 while the engine stands still
+ */
+unsigned long StepEngineGetInterval()
+{
+    unsigned long ticks = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ( STEP_ENGINE_RUNNING ) { ticks = STEP_ENGINE_NEXT_TICKS; }
+    }
+    return ticks / STEP_ENGINE_TICKS_PER_US;
+}
+
+
+/*****************************************************
+ * StepEngineSetDirection( bool direction )
+ * LOW = clockwise rotation, the position increases
+ */
+void StepEngineSetDirection( bool direction )
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        STEP_ENGINE_DIRECTION = direction;
+
+        if ( direction == HIGH ) { *DIR_PORT |= DIR_MASK; }
+        else { *DIR_PORT &= ~DIR_MASK; }
+    }
+}
+
+
+/*****************************************************
+ * StepEngineGetDirection()
+ */
+bool StepEngineGetDirection()
+{
+    return STEP_ENGINE_DIRECTION;
+}
+
+
+/*****************************************************
+ * StepEngineIsRunning()
+ * returns true as long as there are steps to do
+ */
+bool StepEngineIsRunning()
+{
+    return STEP_ENGINE_RUNNING;
+}
+
+
+/*****************************************************
+ * StepEngineGetPosition()
+ * returns the current position of the motor in steps
+ */
+unsigned long StepEngineGetPosition()
+{
+    unsigned long position;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        position = STEP_ENGINE_POSITION;
+    }
+    return position;
+}
+
+
+/*****************************************************
+ * StepEngineSetPosition( unsigned long position )
+ * Overwrites the current position, e.g. after an endstop
+ * has been reached
+ */
+void StepEngineSetPosition( unsigned long position )
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        STEP_ENGINE_POSITION = position;
+    }
+}
+
+
+/*****************************************************
+ * StepEngineGetStepsDone()
+ * returns the number of steps done since StepEngineStart()
+ */
+unsigned long StepEngineGetStepsDone()
+{
+    unsigned long stepsDone;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stepsDone = STEP_ENGINE_STEPS_DONE;
+    }
+    return stepsDone;
+}
+
+
+/*****************************************************
+ * StepEngineTakeEndStopEvent( uint8_t endStop )
+ * returns true once if the endstop (STEP_ENGINE_ENDSTOP_A or
+ * STEP_ENGINE_ENDSTOP_B) has stopped the engine since StepEngineStart()
+ */
+bool StepEngineTakeEndStopEvent( uint8_t endStop )
+{
+    bool tripped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tripped = ( STEP_ENGINE_END_STOP_EVENTS & endStop ) != 0;
+        STEP_ENGINE_END_STOP_EVENTS &= ~endStop;
+    }
+    return tripped;
+}
+
+
+/*****************************************************
+ * StepEngineGetEndStopPosition()
+ * returns the position where the last endstop has stopped the engine
+ */
+unsigned long StepEngineGetEndStopPosition()
+{
+    unsigned long position;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        position = STEP_ENGINE_END_STOP_POSITION;
+    }
+    return position;
+}
+
+
+/*****************************************************
+ * StepEngineJitterEnable( bool enabled )
+ * Switches the jitter measurement on or off, switching it on
+ * clears the histogram and starts Timer5 as a free running counter
+ */
+void StepEngineJitterEnable( bool enabled )
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ( enabled )
+        {
+            // normal mode, prescaler 8 like Timer3
+            TCCR5A = 0;
+            TCCR5C = 0;
+            TIMSK5 = 0;
+            TCCR5B = _BV(CS51);
+
+            memset( (void *)&STEP_ENGINE_JITTER, 0, sizeof(STEP_ENGINE_JITTER) );
+        }
+
+        STEP_ENGINE_JITTER.enabled = enabled;
+    }
+}
+
+
+/*****************************************************
+ * StepEngineGetJitter( StepEngineJitter *jitter )
+ * Copies the jitter measurement
+ */
+void StepEngineGetJitter( StepEngineJitter *jitter )
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy( jitter, (const void *)&STEP_ENGINE_JITTER, sizeof(StepEngineJitter) );
+    }
+}
+
+
+/*****************************************************
+ * Timer3 compare match A
+ * Raises PUL, counts the step and loads the next interval
+ */
+ISR(TIMER3_COMPA_vect)
+{
+    PROFILE(PROFILER_STEP_ISR);
+
+    // still waiting for the rest of a long interval
+    if ( STEP_ENGINE_PENDING_TICKS > 0 )
+    {
+        StepEngineLoadTicks( STEP_ENGINE_PENDING_TICKS );
+        return;
+    }
+
+    if ( STEP_ENGINE_RUNNING == false ) { return; }
+
+    // the endstop is read right before every pulse, so the motor never
+    // does a step after its switch has closed, no matter how slow it runs
+    uint8_t endStop = StepEngineClosedEndStop();
+    if ( endStop != STEP_ENGINE_ENDSTOP_NONE )
+    {
+        STEP_ENGINE_END_STOP_EVENTS |= endStop;
+        STEP_ENGINE_END_STOP_POSITION = STEP_ENGINE_POSITION;
+        STEP_ENGINE_RUNNING = false;
+
+        // PUL is already low, switch the timer off right away
+        TCCR3B = 0;
+        TIMSK3 = 0;
+        return;
+    }
+
+    *PUL_PORT |= PUL_MASK;
+
+    // the width counts from the rising edge, not from the compare match, a
+    // compare match B that is already due belongs to the delayed compare match A
+    uint16_t pulseEnd = TCNT3 + STEP_ENGINE_PULSE_TICKS;
+    OCR3B = pulseEnd;
+    TIFR3 = _BV(OCF3B);
+    StepEngineKeepPulse( pulseEnd );
+
+    if ( STEP_ENGINE_JITTER.enabled ) { StepEngineMeasureJitter(); }
+
+    if ( STEP_ENGINE_DIRECTION == HIGH ) { STEP_ENGINE_POSITION--; }
+    else { STEP_ENGINE_POSITION++; }
+
+    STEP_ENGINE_STEPS_DONE++;
+
+    // last step done, compare match B lowers PUL and switches the timer off
+    if ( STEP_ENGINE_STEPS != STEP_ENGINE_CONTINUOUS && STEP_ENGINE_STEPS_DONE >= STEP_ENGINE_STEPS )
+    {
+        STEP_ENGINE_RUNNING = false;
+        return;
+    }
+
+    if ( STEP_ENGINE_PROFILED )
+    {
+        STEP_ENGINE_NEXT_TICKS = StepEngineNextRampInterval() * STEP_ENGINE_TICKS_PER_US;
+    }
+
+    STEP_ENGINE_EDGE_TICKS = STEP_ENGINE_NEXT_TICKS;
+    StepEngineLoadTicks( STEP_ENGINE_NEXT_TICKS );
+    StepEngineKeepPulse( pulseEnd );
+}
+
+
+/*****************************************************
+ * Timer3 compare match B
+ * Ends the PUL pulse
+ */
+ISR(TIMER3_COMPB_vect)
+{
+    *PUL_PORT &= ~PUL_MASK;
+
+    if ( STEP_ENGINE_RUNNING == false )
+    {
+        TCCR3B = 0;
+        TIMSK3 = 0;
+    }
+}
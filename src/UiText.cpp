@@ -0,0 +1,140 @@
+#include "UiText.h"
+
+// German, a line of the display has room for 14 characters
+static const char TEXT_DE_LOKLIFT[] PROGMEM = "LokLift";
+static const char TEXT_DE_CONTROLLER[] PROGMEM = "Controller";
+static const char TEXT_DE_STARTING[] PROGMEM = "Starte";
+static const char TEXT_DE_HOMING[] PROGMEM = "Kalibriere ...";
+static const char TEXT_DE_TRACK_CLEAR[] PROGMEM = "Bahn frei!";
+static const char TEXT_DE_POSITION[] PROGMEM = "Position:";
+static const char TEXT_DE_OUT_OF_RANGE[] PROGMEM = "Ziel zu weit!";
+static const char TEXT_DE_DONE[] PROGMEM = "Fertig!";
+static const char TEXT_DE_TARGET_SLOT[] PROGMEM = "Ziel: Gleis %d";
+static const char TEXT_DE_TARGET_POSITION[] PROGMEM = "Ziel: %lu";
+static const char TEXT_DE_POSITION_VALUE[] PROGMEM = "Pos: %-9lu";
+static const char TEXT_DE_SPEED[] PROGMEM = "%4u U/min    ";
+static const char TEXT_DE_MEASURE_TRACK[] PROGMEM = "Strecke messen";
+static const char TEXT_DE_ENDSTOP_A[] PROGMEM = "Endstop A";
+static const char TEXT_DE_ENDSTOP_B[] PROGMEM = "Endstop B";
+static const char TEXT_DE_SAVED[] PROGMEM = "Gespeichert";
+static const char TEXT_DE_DRIVE_MODE[] PROGMEM = "Lauf-Modus";
+static const char TEXT_DE_STEP_MODE[] PROGMEM = "Schritt-Modus";
+static const char TEXT_DE_SAVE_POSITION[] PROGMEM = "Position";
+static const char TEXT_DE_SAVE_QUESTION[] PROGMEM = "Speichern?";
+static const char TEXT_DE_BUTTON[] PROGMEM = "Schalter: ";
+static const char TEXT_DE_CANCELLED[] PROGMEM = "Abbruch";
+static const char TEXT_DE_SETTING_MAX_RPM[] PROGMEM = "MaxRPM:";
+static const char TEXT_DE_SETTING_MIN_RPM[] PROGMEM = "MinRPM:";
+static const char TEXT_DE_SETTING_CAL_RPM[] PROGMEM = "CalRPM:";
+static const char TEXT_DE_SETTING_ACCEL_STEPS[] PROGMEM = "AccStp:";
+static const char TEXT_DE_SETTING_PPR[] PROGMEM = "MotPPR:";
+static const char TEXT_DE_SETTING_PROFILE[] PROGMEM = "Profil:";
+static const char TEXT_DE_SETTING_LIMIT[] PROGMEM = "Limit:";
+static const char TEXT_DE_SETTING_LANGUAGE[] PROGMEM = "Sprache";
+static const char TEXT_DE_PROFILE_LINEAR[] PROGMEM = "Lin";
+static const char TEXT_DE_PROFILE_SCURVE[] PROGMEM = "S";
+static const char TEXT_DE_LANGUAGE_NAME[] PROGMEM = "DE";
+
+// English
+static const char TEXT_EN_LOKLIFT[] PROGMEM = "LokLift";
+static const char TEXT_EN_CONTROLLER[] PROGMEM = "Controller";
+static const char TEXT_EN_STARTING[] PROGMEM = "Starting";
+static const char TEXT_EN_HOMING[] PROGMEM = "Homing ...";
+static const char TEXT_EN_TRACK_CLEAR[] PROGMEM = "Track clear!";
+static const char TEXT_EN_POSITION[] PROGMEM = "Position:";
+static const char TEXT_EN_OUT_OF_RANGE[] PROGMEM = "Out of range!";
+static const char TEXT_EN_DONE[] PROGMEM = "Done!";
+static const char TEXT_EN_TARGET_SLOT[] PROGMEM = "Target: #%d";
+static const char TEXT_EN_TARGET_POSITION[] PROGMEM = "Target: %lu";
+static const char TEXT_EN_POSITION_VALUE[] PROGMEM = "Pos: %-9lu";
+static const char TEXT_EN_SPEED[] PROGMEM = "%4u rpm      ";
+static const char TEXT_EN_MEASURE_TRACK[] PROGMEM = "Measure track";
+static const char TEXT_EN_ENDSTOP_A[] PROGMEM = "Endstop A";
+static const char TEXT_EN_ENDSTOP_B[] PROGMEM = "Endstop B";
+static const char TEXT_EN_SAVED[] PROGMEM = "Saved";
+static const char TEXT_EN_DRIVE_MODE[] PROGMEM = "Drive mode";
+static const char TEXT_EN_STEP_MODE[] PROGMEM = "Step mode";
+static const char TEXT_EN_SAVE_POSITION[] PROGMEM = "Save";
+static const char TEXT_EN_SAVE_QUESTION[] PROGMEM = "position?";
+static const char TEXT_EN_BUTTON[] PROGMEM = "Button: ";
+static const char TEXT_EN_CANCELLED[] PROGMEM = "Cancelled";
+static const char TEXT_EN_SETTING_MAX_RPM[] PROGMEM = "MaxRPM:";
+static const char TEXT_EN_SETTING_MIN_RPM[] PROGMEM = "MinRPM:";
+static const char TEXT_EN_SETTING_CAL_RPM[] PROGMEM = "CalRPM:";
+static const char TEXT_EN_SETTING_ACCEL_STEPS[] PROGMEM = "AccStp:";
+static const char TEXT_EN_SETTING_PPR[] PROGMEM = "MotPPR:";
+static const char TEXT_EN_SETTING_PROFILE[] PROGMEM = "Ramp:";
+static const char TEXT_EN_SETTING_LIMIT[] PROGMEM = "Limit:";
+static const char TEXT_EN_SETTING_LANGUAGE[] PROGMEM = "Lang.:";
+static const char TEXT_EN_PROFILE_LINEAR[] PROGMEM = "Lin";
+static const char TEXT_EN_PROFILE_SCURVE[] PROGMEM = "S";
+static const char TEXT_EN_LANGUAGE_NAME[] PROGMEM = "EN";
+
+// the table is in flash as well, one row per UiTextId in the order of the enum
+static const char * const UI_TEXT_TABLE[][UI_TEXT_LANGUAGE_COUNT] PROGMEM =
+{
+    { TEXT_DE_LOKLIFT, TEXT_EN_LOKLIFT },
+    { TEXT_DE_CONTROLLER, TEXT_EN_CONTROLLER },
+    { TEXT_DE_STARTING, TEXT_EN_STARTING },
+    { TEXT_DE_HOMING, TEXT_EN_HOMING },
+    { TEXT_DE_TRACK_CLEAR, TEXT_EN_TRACK_CLEAR },
+    { TEXT_DE_POSITION, TEXT_EN_POSITION },
+    { TEXT_DE_OUT_OF_RANGE, TEXT_EN_OUT_OF_RANGE },
+    { TEXT_DE_DONE, TEXT_EN_DONE },
+    { TEXT_DE_TARGET_SLOT, TEXT_EN_TARGET_SLOT },
+    { TEXT_DE_TARGET_POSITION, TEXT_EN_TARGET_POSITION },
+    { TEXT_DE_POSITION_VALUE, TEXT_EN_POSITION_VALUE },
+    { TEXT_DE_SPEED, TEXT_EN_SPEED },
+    { TEXT_DE_MEASURE_TRACK, TEXT_EN_MEASURE_TRACK },
+    { TEXT_DE_ENDSTOP_A, TEXT_EN_ENDSTOP_A },
+    { TEXT_DE_ENDSTOP_B, TEXT_EN_ENDSTOP_B },
+    { TEXT_DE_SAVED, TEXT_EN_SAVED },
+    { TEXT_DE_DRIVE_MODE, TEXT_EN_DRIVE_MODE },
+    { TEXT_DE_STEP_MODE, TEXT_EN_STEP_MODE },
+    { TEXT_DE_SAVE_POSITION, TEXT_EN_SAVE_POSITION },
+    { TEXT_DE_SAVE_QUESTION, TEXT_EN_SAVE_QUESTION },
+    { TEXT_DE_BUTTON, TEXT_EN_BUTTON },
+    { TEXT_DE_CANCELLED, TEXT_EN_CANCELLED },
+    { TEXT_DE_SETTING_MAX_RPM, TEXT_EN_SETTING_MAX_RPM },
+    { TEXT_DE_SETTING_MIN_RPM, TEXT_EN_SETTING_MIN_RPM },
+    { TEXT_DE_SETTING_CAL_RPM, TEXT_EN_SETTING_CAL_RPM },
+    { TEXT_DE_SETTING_ACCEL_STEPS, TEXT_EN_SETTING_ACCEL_STEPS },
+    { TEXT_DE_SETTING_PPR, TEXT_EN_SETTING_PPR },
+    { TEXT_DE_SETTING_PROFILE, TEXT_EN_SETTING_PROFILE },
+    { TEXT_DE_SETTING_LIMIT, TEXT_EN_SETTING_LIMIT },
+    { TEXT_DE_SETTING_LANGUAGE, TEXT_EN_SETTING_LANGUAGE },
+    { TEXT_DE_PROFILE_LINEAR, TEXT_EN_PROFILE_LINEAR },
+    { TEXT_DE_PROFILE_SCURVE, TEXT_EN_PROFILE_SCURVE },
+    { TEXT_DE_LANGUAGE_NAME, TEXT_EN_LANGUAGE_NAME }
+};
+
+static_assert( sizeof(UI_TEXT_TABLE) / sizeof(UI_TEXT_TABLE[0]) == UI_TEXT_COUNT, "UI_TEXT_TABLE needs one row per UiTextId" );
+
+/********** GLOBALS ******************************************************/
+static byte UI_TEXT_LANGUAGE                    = UI_TEXT_GERMAN;   // the language of all texts
+/*************************************************************************/
+
+
+/*****************************************************
+ * UiTextSetLanguage( byte language )
+ * Switches all texts to another language
+ *
+ * language: UI_TEXT_GERMAN or UI_TEXT_ENGLISH, anything
+ *           else falls back to UI_TEXT_GERMAN
+ */
+void UiTextSetLanguage( byte language )
+{
+    UI_TEXT_LANGUAGE = language < UI_TEXT_LANGUAGE_COUNT ? language : UI_TEXT_GERMAN;
+}
+
+
+/*****************************************************
+ * UiTextGet( UiTextId id )
+ * returns the address of the text in flash in the current language
+ */
+PGM_P UiTextGet( UiTextId id )
+{
+    if ( id >= UI_TEXT_COUNT ) { return TEXT_DE_LOKLIFT; }
+
+    return (PGM_P)pgm_read_ptr( &UI_TEXT_TABLE[id][UI_TEXT_LANGUAGE] );
+}
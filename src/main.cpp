@@ -1,17 +1,34 @@
 #include <Arduino.h>
 #include <ClickEncoder.h>
 #include <TimerOne.h>
-#include <Bounce2.h>
 #include <Wire.h>
 #include <SPI.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_PCD8544.h>
-#include <EEPROM.h>
+#include "StepEngine.h"
+#include "RampTable.h"
+#include "MotionMath.h"
+#include "EepromWriter.h"
+#include "ConfigStore.h"
+#include "ButtonScanner.h"
+#include "Log.h"
+#include "SerialProtocol.h"
+#include "DisplayBuffer.h"
+#include "MemoryMonitor.h"
+#include "UiText.h"
+#include "PositionJournal.h"
+#include "DriftMonitor.h"
+#include "Profiler.h"
 
 /********** PINS MOTOR ***************************************************/
 #define PIN_DRIVER_ENA 22 // ENA+ Pin
 #define PIN_DRIVER_PUL 24 // PUL+ Pin
 #define PIN_DRIVER_DIR 26 // DIR+ Pin
+#define MOTOR_START_PULSE_DELAY 15000 // the pulse delay at standstill, should be quite high to start slow
+#define MOTOR_HOMING_CREEP_PULSE_DELAY 5000 // the pulse delay of the slow approach that sets position 0
+#define MOTOR_HOMING_RELEASE_STEPS 100 // steps back from endstop A before the slow approach
+#define MOTOR_HOMING_MARGIN_PERCENT 5 // the fast part of the homing stops this far in front of the expected endstop A
+#define MOTOR_DRIVE_NO_LIMIT 0x7FFFFFFF // the drive limit towards endstop B without a measured track, only the endstop stops there
 /*************************************************************************/
 
 /********** PINS ROTARY ENCODER ******************************************/
@@ -33,15 +50,72 @@ static TimerOne timer;
 // SWITCH 13: 52 (MODUS SWITCH)
 // SWITCH 14: 23 (PIN_ROTARY_ENCODER_SW)
 #define NUM_BUTTONS 14
-const uint8_t BUTTON_PINS[NUM_BUTTONS] = {44, 46, 48, 50, 36, 38, 40, 42, 28, 30, 32, 34, 52, PIN_ROTARY_ENCODER_SW};
-Bounce *buttons = new Bounce[NUM_BUTTONS];
 /*************************************************************************/
 
 /********** PINS END STOPS ***********************************************/
+// the StepEngine reads the endstops right before every step, pins 8 and 9 (PH5, PH6)
+// have no pin change interrupt on the Mega, so this is the earliest point to react
 #define PIN_ENDSTOP_A 8 // Endstop switch pin
 #define PIN_ENDSTOP_B 9 // Endstop switch pin
-Bounce endStopA = Bounce();
-Bounce endStopB = Bounce();
+/*************************************************************************/
+
+/********** INPUTS *******************************************************/
+// the ButtonScanner debounces the buttons and the endstops in the 1 ms timer interrupt,
+// the array position is the bit in its masks and the button id in BUTTON_PRESSED
+#define NUM_INPUTS 16
+#define INPUT_ENDSTOP_A 14
+#define INPUT_ENDSTOP_B 15
+#define BUTTONS_MASK ((1U << NUM_BUTTONS) - 1)
+const uint8_t INPUT_PINS[NUM_INPUTS] = {44, 46, 48, 50, 36, 38, 40, 42, 28, 30, 32, 34, 52, PIN_ROTARY_ENCODER_SW, PIN_ENDSTOP_A, PIN_ENDSTOP_B};
+/*************************************************************************/
+
+/********** MOTOR SETTINGS MENU ******************************************/
+// the labels are UI_TEXT_SETTING_MAX_RPM and the following texts
+#define MOTOR_SETTINGS_ROWS 8           // number of settings in the menu
+#define MOTOR_SETTINGS_VISIBLE_ROWS 5   // number of rows that fit on the display
+/*************************************************************************/
+
+/********** MOVE QUEUE ***************************************************/
+#define MOVE_QUEUE_SIZE 8               // number of targets that can wait behind the current move
+unsigned long MOVE_QUEUE[MOVE_QUEUE_SIZE];  // the waiting targets in steps, a ring buffer
+byte MOVE_QUEUE_HEAD = 0;               // index of the next target
+byte MOVE_QUEUE_COUNT = 0;              // number of waiting targets
+/*************************************************************************/
+
+/********** TELEMETRY ****************************************************/
+#define TELEMETRY_MIN_PERIOD 10         // the shortest period between two telemetry frames in milliseconds
+unsigned int TELEMETRY_PERIOD = 0;      // milliseconds between two telemetry frames, 0 = off
+unsigned long TELEMETRY_TIME = 0;       // millis() of the last telemetry frame
+/*************************************************************************/
+
+/********** MEMORY REPORT ************************************************/
+#define MEMORY_REPORT_PERIOD 600000UL   // milliseconds between two memory reports in the log
+unsigned long MEMORY_REPORT_TIME = 0;   // millis() of the last memory report
+/*************************************************************************/
+
+/********** CALIBRATION **************************************************/
+#define CALIBRATION_RUNS 3              // the track is measured this many times, the mean is stored
+#define CALIBRATION_MARGIN_PERCENT 2    // the fast part of a measurement stops this far in front of the endstop
+#define CALIBRATION_STORED_MARGIN_PERCENT 10 // the same with the stored track length, the track may have changed since
+byte CALIBRATION_RUN = 0;               // the number of measurements done so far
+unsigned long CALIBRATION_ESTIMATE = 0; // the expected track length in steps, 0 = unknown
+unsigned long CALIBRATION_MARGIN = 0;   // the steps the fast part stops in front of the endstop
+unsigned long CALIBRATION_STEPS = 0;    // the steps counted from endstop B so far
+unsigned long CALIBRATION_SUM = 0;      // the sum of all measurements, for the mean
+unsigned long CALIBRATION_MIN = 0;      // the shortest measurement
+unsigned long CALIBRATION_MAX = 0;      // the longest measurement
+/*************************************************************************/
+
+/********** POSITION JOURNAL *********************************************/
+#define POSITION_REST_DELAY 1000        // milliseconds the motor has to stand still before its position is stored
+#define BOOT_MENU_TIMEOUT 3000          // milliseconds the boot screen waits for the configuration buttons
+#define POSITION_REZERO_AT_A true       // set the position to 0 whenever a move or drive mode runs into endstop A
+#define POSITION_REZERO_MAX_PERCENT 2   // largest drift at endstop A in percent of the track that is taken as lost steps
+bool POSITION_KNOWN = false;            // true once the position is known from homing, calibration or the journal
+bool POSITION_REFERENCED = false;       // true once the position has been known, the StepEngine has counted every step since
+unsigned long POSITION_LAST = 0;        // the position PositionJournalTask() has seen in the last loop
+unsigned long POSITION_MOVE_TIME = 0;   // millis() of the last loop the motor has moved in
+bool POSITION_HOMING_NEEDED = false;    // set if endstop A has tripped too far from position 0, UiTask() homes then
 /*************************************************************************/
 
 /********** PINS DISPLAY *************************************************/
@@ -50,27 +124,76 @@ Bounce endStopB = Bounce();
 // pin 5 - Data/Command select (D/C)
 // pin 6 - LCD chip select (CS)
 // pin 7 - LCD reset (RST)
-Adafruit_PCD8544 display = Adafruit_PCD8544(3, 4, 5, 6, 7);
+// the screens draw into display, DisplayTask() sends the changes to the lcd once per loop
+#define DISPLAY_SLICE_BUDGET 300        // microseconds DisplayTask() may spend on the LCD per loop
+#define DISPLAY_REFRESH_PERIOD 250      // milliseconds between two updates of the live values on the screens
+Adafruit_PCD8544 lcd = Adafruit_PCD8544(3, 4, 5, 6, 7);
+DisplayBuffer display(lcd);
+unsigned long DISPLAY_WORST_SLICE = 0;  // the longest LCD slice that has been reported
+unsigned long DISPLAY_REFRESH_TIME = 0; // millis() of the last update of the live values
+/*************************************************************************/
+
+/********** STATE MACHINES ***********************************************/
+// the states of the user interface, every state has its own screen
+enum UiState
+{
+    UI_BOOT,                    // boot screen, waits BOOT_MENU_TIMEOUT for the configuration buttons
+    UI_HOMING,                  // waits for the move to endstop A after boot
+    UI_MAIN,                    // main screen with drive mode and step mode
+    UI_MOVING,                  // waits for the move to a stored position
+    UI_SAVE_POSITION,           // asks for the button to save the current position to
+    UI_SETTINGS,                // motor settings menu
+    UI_CALIBRATING,             // shows the progress of the track measurement
+    UI_MESSAGE                  // keeps a message for MESSAGE_DURATION, then enters MESSAGE_NEXT_STATE
+};
+
+// the states of the motion sequences, drive mode and step mode are run by UI_MAIN
+enum MotionState
+{
+    MOTION_IDLE,
+    MOTION_HOMING_FAST,         // moves at full speed to just before the expected endstop A
+    MOTION_HOMING,              // moves to endstop A at calibration speed
+    MOTION_HOMING_RELEASE,      // moves MOTOR_HOMING_RELEASE_STEPS away until endstop A is open
+    MOTION_HOMING_CREEP,        // moves slowly back to endstop A, that is position 0
+    MOTION_HOMING_BACK_OFF,     // moves 10% of the track away from endstop A
+    MOTION_MOVING,              // moves to MOVE_TARGET_POSITION
+    MOTION_REVERSING,           // brakes to turn around to a new MOVE_TARGET_POSITION behind the motor
+    MOTION_CALIBRATE_TO_B,      // moves fast to just before endstop B, then slowly onto it
+    MOTION_CALIBRATE_TO_A,      // counts the steps back to endstop A, fast and then slowly
+    MOTION_CALIBRATE_BACK_OFF   // moves 10% of the track away from endstop A
+};
 /*************************************************************************/
 
 /********** GLOBALS ******************************************************/
+#define MAIN_SCREEN_DOUBLE_CLICK 14                     // stands for a double click of the knob in MAIN_SCREEN_PENDING
 int BUTTON_PRESSED                          = -1;       // the array ID of the button that has been pressed last
-unsigned long TOTAL_TRACK_STEPS             = 0;        // [EEPROM] the number of steps from one end stop to the the other end stop
+uint16_t BUTTON_EVENTS                      = 0;        // button presses taken from the ButtonScanner that are not handled yet
 unsigned long START_TIME                    = 0;        // used for different situations where a START_TIME is needed
-unsigned long CURRENT_STEP_POSITION         = 0;        // the current position of the motor in steps
 int16_t ENCODER_CHANGE                      = 0;        // the current encoder change value
 int16_t ENCODER_VALUE                       = 0;        // the current accumulated encoder value
 int16_t ENCODER_VALUE_OLD                   = 0;        // old encoder position (needed for reading encoder changes)
-unsigned long TARGET_POSITIONS[12];                 // [EEPROM] holds the 12 stored positions loaded from EEPROM in steps
+Button::eButtonStates ENCODER_BUTTON        = Button::Open; // the click state of the encoder knob in the current loop
+int MAIN_SCREEN_PENDING                     = -1;       // button pressed while the motor was running, handled at standstill, MAIN_SCREEN_DOUBLE_CLICK for the knob
 
 byte MOTOR_MODE                             = 0;        // different motorModes: 1 continuos, 2 single step
-unsigned int MOTOR_PPR                      = 200;      // [EEPROM] pulses per revolution of the motor, needed to caclulate the motor speed
-unsigned long MOTOR_PULSE_DELAY             = 2000;     // the pulse delay we use in the MotorStep() function = stepping speed
-boolean MOTOR_DIRECTION                     = LOW;      // LOW = clockwise rotation
-unsigned int MOTOR_MIN_SPEED_RPM            = 25;       // [EEPROM] minimum motor speed in rounds per minute
-unsigned int MOTOR_MAX_SPEED_RPM            = 420;      // [EEPROM] maximum motor speed in rounds per minute
-unsigned int MOTOR_CALIBRATION_SPEED_RPM    = 300;      // [EEPROM] this speed is used during calibration in rpm
-unsigned int ACCEL_STEPS                    = 400;      // [EEPROM] the number of steps for the acceleration phase in a move
+unsigned long MOTOR_PULSE_DELAY             = 2000;     // the pulse delay we hand to the StepEngine = stepping speed
+
+UiState UI_STATE                            = UI_BOOT;  // the current state of the user interface
+UiState MESSAGE_NEXT_STATE                  = UI_MAIN;  // the state UI_MESSAGE enters when MESSAGE_DURATION has passed
+UiState SETTINGS_RETURN_STATE               = UI_MAIN;  // the state the motor settings menu returns to
+unsigned long MESSAGE_DURATION              = 0;        // how long UI_MESSAGE keeps the message in milliseconds
+byte BOOT_DOTS                              = 0;        // the number of dots on the boot screen
+byte SETTINGS_SELECTED_COL                  = 0;        // the selected column of the motor settings menu
+byte SETTINGS_SELECTED_ROW                  = 0;        // the selected row of the motor settings menu
+bool SETTINGS_CHANGED                       = false;    // true as soon as a motor setting has been changed in the menu
+MotionState MOTION_STATE                    = MOTION_IDLE; // the current motion sequence
+MotionState MOTION_STATE_SHOWN              = MOTION_IDLE; // the motion state the calibration screen shows
+unsigned long HOMING_START_TIME             = 0;        // millis() at the start of the homing, for the homing time in the log
+unsigned long MOVE_TARGET_POSITION          = 0;        // the target position of the current move in steps
+unsigned long MOVE_START_POSITION           = 0;        // the position the move to MOVE_TARGET_POSITION has started from, for the progress bar
+unsigned long MOVING_SCREEN_TARGET          = 0;        // the target the move screen shows
+byte MOVING_SCREEN_QUEUE                    = 0;        // the number of waiting targets the move screen shows
+byte MOVE_END_REASON                        = SERIAL_PROTOCOL_MOVE_REACHED; // why the current move ends, sent to the host when it is done
 
 /*************************************************************************/
 
@@ -78,32 +201,76 @@ unsigned int ACCEL_STEPS                    = 400;      // [EEPROM] the number o
 // FUNCTION DECLARATIONS //////////////////////////////////////////////////////////////////////////////////
 //
 //
-int CalculateEEPROMAddressForButton( byte buttonID );
-bool CheckButton(byte id);
+void BootFinish();
+void BootScreenUpdate();
+void CalibrationUpdate();
 int CheckButtons();
 bool CheckEndStopA();
 bool CheckEndStopB();
-int Delay2RPM( int delayValue );
+void CheckEndStopDrift( byte endStop, unsigned long expected );
+unsigned int Delay2RPM( unsigned long delayValue );
 void DisplayClear();
-void DisplayMessage(int x, int y, String message, bool inverted=false);
+void DisplayMessage(int x, int y, const char *message, bool inverted=false);
+void DisplayMessage(int x, int y, const __FlashStringHelper *message, bool inverted=false);
+void DisplayNumber(int x, int y, unsigned long value, bool inverted=false);
+void DisplaySetPosition(int x, int y, bool inverted);
+void DisplayTask();
 void DrawMotorSettings( byte selectedCol, byte selectedRow );
+void DrawMainScreenValues();
+void DrawMovingScreen();
+void DrawMovingValues();
 void EncoderReset();
+void InputTask();
 void InterruptTimerCallback();
-unsigned int LerpLinear(unsigned int from, unsigned int to, unsigned int deltaSteps);
-long LinearMap(long ax, long aMin, long aMax, long bMin, long bMax);
 void LoadEEPROMData();
+void MainScreenUpdate();
+void MemoryReportTask();
+void MotionTask();
+void MotorBackOffEndStopA();
 void MotorChangeDirection();
+unsigned long MotorDriveLimit( bool direction );
+unsigned long MotorEstimateArrival();
+void MotorDriveUpdate();
 void MotorCalibrateEndStops();
+void MotorCalibrateFinish();
+void MotorCalibrateRun( bool direction, unsigned long distance );
 void MotorSettings();
-void MotorStep();
-void MotorMoveTo( unsigned long targetPosition );
+void MotorSettingsUpdate();
+unsigned int MotorSettingGet( byte row );
+bool MotorSettingSet( byte row, unsigned int value );
+bool MotorMoveTo( unsigned long targetPosition );
+void MotorMoveDone();
+bool MotorMoveToButton( byte buttonID );
+void MotorBlendNextMove();
+bool MotorIsMoving();
+void MotorSkipMove();
+void MotorStopMove();
 void MotorMoveToEndStopA();
+void MotorHomingApproach();
+void MotorHomingRelease();
 void MotorModeSwitch();
+void MotorModeUpdate();
+void MotorStartMove();
+int MotorTargetSlot( unsigned long targetPosition );
+void MoveQueueClear();
+unsigned long MoveQueuePop();
+bool MoveQueuePush( unsigned long targetPosition );
+void MovingScreenUpdate();
+void PositionJournalTask();
 void PrepareForMainLoop();
-unsigned int RPM2Delay( int rpm );
+bool RemoteCanMove();
+byte RemoteFlags();
+void RemoteHandleCommand( byte command, byte sequence, const byte *payload, byte length );
+byte RemoteMoveTo( unsigned long targetPosition, byte flags );
+unsigned long RPM2Delay( unsigned int rpm );
 void SavePosition();
+void SavePositionUpdate();
 void SaveMotorSettings();
-void UpdateDisplay();
+void TelemetryTask();
+void UiEnterState( UiState state );
+void UiShowMessage( unsigned long duration, UiState nextState );
+void UiTask();
+void UpdateRampTable();
 
 
 
@@ -114,22 +281,25 @@ void UpdateDisplay();
 //
 void setup()
 {
-    Serial.begin(9600);
+    // commands from the host are handled by RemoteHandleCommand()
+    SerialProtocolInit(RemoteHandleCommand);
 
     /* LCD DISPLAY SETUP */
-    display.begin();
-    display.setContrast(57);
+    lcd.begin();
+    lcd.setContrast(57);
 
     DisplayClear();
-    DisplayMessage(20, 0, "LokLift");
-    DisplayMessage(10, 10, "Controller");
-    DisplayMessage(0, 25, "Starte");
+    DisplayMessage(20, 0, UI_TEXT(UI_TEXT_LOKLIFT));
+    DisplayMessage(10, 10, UI_TEXT(UI_TEXT_CONTROLLER));
+    DisplayMessage(0, 25, UI_TEXT(UI_TEXT_STARTING));
     display.drawChar(0, 40, 0x2A, BLACK, WHITE, 1);
     display.drawChar(78, 40, 0x12, BLACK, WHITE, 1);
+    display.flush();
 
     // Load Data from EEPROM
-    //DebugPrintEEPROM();
     LoadEEPROMData();
+    DriftMonitorInit();
+    PositionJournalInit();
 
     /* ROTARY ENCODER SETUP */
 
@@ -144,1142 +314,2191 @@ void setup()
 
     /* BUTTONS SETUP */
 
-    // setup 14 button bounce objects
-    for (int i = 0; i < NUM_BUTTONS; i++)
-    {
-        buttons[i].attach(BUTTON_PINS[i], INPUT_PULLUP); // setup the bounce instance for the current button
-        buttons[i].interval(25);                         // interval in ms
-    }
-
-    /* SETUP ENDSTOP BUTTONS */
-
-    endStopA.attach(PIN_ENDSTOP_A, INPUT_PULLUP);
-    endStopA.interval(25);
-    endStopB.attach(PIN_ENDSTOP_B, INPUT_PULLUP);
-    endStopB.interval(25);
+    // the 14 buttons and both endstops are scanned by InterruptTimerCallback()
+    ButtonScannerInit(INPUT_PINS, NUM_INPUTS);
 
     /* MOTOR SETUP */
 
-    pinMode(PIN_DRIVER_DIR, OUTPUT);
-    pinMode(PIN_DRIVER_PUL, OUTPUT);
+    StepEngineInit(PIN_DRIVER_PUL, PIN_DRIVER_DIR);
+    StepEngineSetEndStops(PIN_ENDSTOP_A, PIN_ENDSTOP_B);
 
     // enable motor
     digitalWrite(PIN_DRIVER_ENA, LOW);
 
-    // check five seconds for button presses during startup to enter configuration modes
-    bool gotoMotorCalibrateEndStops = false;
-    bool gotoMotorSettings = false;
-
-    START_TIME = millis();
-    while ( millis() < START_TIME + 5000 )
-    { 
-        unsigned long m = millis();
-        if ( m > START_TIME && m < START_TIME + 1000 ) { DisplayMessage(40, 25, "."); }
-        else if ( m > START_TIME && m < START_TIME + 2000 ) { DisplayMessage(40, 25, ".."); }
-        else if ( m > START_TIME && m < START_TIME + 3000 ) { DisplayMessage(40, 25, "..."); }
-        else if ( m > START_TIME && m < START_TIME + 4000 ) { DisplayMessage(40, 25, "...."); }
-        else if ( m > START_TIME && m < START_TIME + 5000 ) { DisplayMessage(40, 25, "....."); }
-        CheckButtons();
-
-        // if button 12 (red button) is pressed on startup then start calibration
-        if (BUTTON_PRESSED == 12)
-        {
-            gotoMotorCalibrateEndStops = true;
-            break;
-        }
-        // if button 13 (rotary knob) is pressed on startup then start motor setup
-        else if (BUTTON_PRESSED == 13)
-        {
-            gotoMotorSettings = true;
-            break;
-        }
-    }
-
-    // reset last button pressed
-    BUTTON_PRESSED = -1;
-
-    if ( gotoMotorCalibrateEndStops ) { MotorCalibrateEndStops(); }
-    else if ( gotoMotorSettings ) { MotorSettings(); }
-
-    DisplayClear();
-    DisplayMessage(20, 0, "LokLift");
-    DisplayMessage(10, 10, "Controller");
-    DisplayMessage(0, 30, "Kalibriere ...");
-
-    MotorMoveToEndStopA();
-
-    // Now motor is at position 0
-    // from now on we need to track every step movement in CURRENT_STEP_POSITION variable
-    // which is handled in MotorStep(). so ALWAYS use MotorStep()
-    CURRENT_STEP_POSITION = 0;
-
-    // move back a little 10% of the TOTAL_TRACK_STEPS to not permanent press endstop A
-    unsigned int tenPercentSteps = round(TOTAL_TRACK_STEPS / 100.0 * 10.0);
-    
-    Serial.print("tenPercentSteps: ");
-    Serial.println(tenPercentSteps);
-    Serial.print("TOTAL_TRACK_STEPS: ");
-    Serial.println(TOTAL_TRACK_STEPS);
-
-    for (size_t i = 0; i < tenPercentSteps; i++)
-    {
-        MotorStep();
-    }
-
-    Serial.print("CURRENT_STEP_POSITION: ");
-    Serial.println(CURRENT_STEP_POSITION);
+#if PROFILER_ENABLED
+    ProfilerInit();
+#endif
 
-    PrepareForMainLoop();
+    // the first memory report goes out right away and shows the baseline
+    MEMORY_REPORT_TIME = millis() - MEMORY_REPORT_PERIOD;
 
-    MOTOR_DIRECTION = HIGH;
+    // check for button presses during startup to enter configuration modes,
+    // the boot screen is a state of the user interface so loop() is already running
+    UiEnterState(UI_BOOT);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 // LOOP ///////////////////////////////////////////////////////////////////////////////////////////////////
 //
+// Every task does a small piece of work and returns, nothing in here may
+// wait for the motor, the user or a timer. Waiting is done by staying in
+// a state and checking again in the next loop.
 //
 void loop()
 {
-    /* BUTTONS CHECK LOOP */
+    PROFILE(PROFILER_LOOP);
+
+    InputTask();
+    SerialProtocolTask();
+    MotionTask();
+    TelemetryTask();
+    UiTask();
+    DisplayTask();
+    PositionJournalTask();
+    EepromWriterTask();
+    MemoryReportTask();
+    LogTask();
+}
 
-    CheckButtons();
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FUNCTION DEFINITIONS ///////////////////////////////////////////////////////////////////////////////////
 
-    // if button 1 to 12 is pressed
-    // drive motor to position
-    if ( BUTTON_PRESSED >= 0 &&  BUTTON_PRESSED <= 11 )
-    {
-        unsigned long targetPosition = 0;
-        EEPROM.get( CalculateEEPROMAddressForButton(BUTTON_PRESSED), targetPosition );
+/*****************************************************
+ * InputTask()
+ * Reads the buttons and the rotary encoder once per loop, so
+ * BUTTON_PRESSED, ENCODER_CHANGE and ENCODER_BUTTON hold the
+ * events of the current loop for all other tasks
+ */
+void InputTask()
+{
+    PROFILE(PROFILER_INPUT);
 
-        // if target position is in the total track steps range
-        // then move to that target 
-        if ( targetPosition <= TOTAL_TRACK_STEPS )
-        {
-            MotorMoveTo( targetPosition );
-        }
+    BUTTON_PRESSED = CheckButtons();
+    ENCODER_CHANGE = rotaryEncoder.getIncrement();
+    ENCODER_BUTTON = rotaryEncoder.getButton();
+}
 
-        // display an error message if target is not in
-        // total track range
-        else
-        {
-            DisplayClear();
-            DisplayMessage(0,0, "Target out of range!");
-            delay(4000);
-            PrepareForMainLoop();
-        }
-        BUTTON_PRESSED = -1;
-    }
 
-    // check for button 12 to initiate saving curent position
-    else if (BUTTON_PRESSED == 12)
-    {
-        SavePosition();
-    }
+/*****************************************************
+ * MotionTask()
+ * Runs the motion sequences. The StepEngine steps the motor in the
+ * background, so this only checks the endstops and starts the next
+ * phase of the sequence as soon as the current one has finished.
+ */
+void MotionTask()
+{
+    PROFILE(PROFILER_MOTION);
 
-    // check for rotay encoder knob switch press
-    // to switch motor mode
-    else if (BUTTON_PRESSED == 13)
+    switch ( MOTION_STATE )
     {
-        MotorModeSwitch();
-        BUTTON_PRESSED = -1;
-    }
+        case MOTION_IDLE:
+            break;
 
-    // check for double click on rotary encoder knob
-    // if double click detected, opens the MotorSettings menu
-    switch (rotaryEncoder.getButton())
-    {
-        case Button::DoubleClicked:
-            Serial.println("Encoder double clicked");
-            MotorSettings();
-            PrepareForMainLoop();
+        case MOTION_HOMING_FAST:
+            // the estimate was wrong, the switch has been touched at speed
+            if ( CheckEndStopA() )
+            {
+                StepEngineStop();
+                MotorHomingRelease();
+            }
+            else if ( !StepEngineIsRunning() ) { MotorHomingApproach(); }
             break;
-        default:
+
+        case MOTION_HOMING:
+            if ( CheckEndStopA() )
+            {
+                StepEngineStop();
+                MotorHomingRelease();
+            }
             break;
-    }
 
+        case MOTION_HOMING_RELEASE:
+            if ( !StepEngineIsRunning() )
+            {
+                // a switch with a wide hysteresis needs more than one release
+                if ( ButtonScannerGetState() & (1U << INPUT_ENDSTOP_A) ) { MotorHomingRelease(); }
+                else
+                {
+                    StepEngineSetDirection(HIGH);
+                    StepEngineStart(STEP_ENGINE_CONTINUOUS, MOTOR_HOMING_CREEP_PULSE_DELAY);
+                    MOTION_STATE = MOTION_HOMING_CREEP;
+                }
+            }
+            break;
 
-    /* MOTOR LOOP MODES */ 
+        case MOTION_HOMING_CREEP:
+            if ( CheckEndStopA() )
+            {
+                StepEngineStop();
+                MotorChangeDirection();
+                MotorBackOffEndStopA();
+                MOTION_STATE = MOTION_HOMING_BACK_OFF;
+            }
+            break;
 
-    // get encoder values
-    ENCODER_CHANGE = rotaryEncoder.getIncrement();
+        case MOTION_HOMING_BACK_OFF:
+            if ( !StepEngineIsRunning() )
+            {
+                LOG_INFO("Homing finished at %lu after %lu ms", StepEngineGetPosition(), millis() - HOMING_START_TIME);
 
-    // CONTINOUS MOTOR MODE aka DRIVE MODE aka LAUF-MODUS
-    // rotary encoder controls the speed
-    if (MOTOR_MODE == 0)
-    {
-        if (ENCODER_CHANGE != 0)
-        {
-            ENCODER_VALUE = rotaryEncoder.getAccumulate();
+                StepEngineSetDirection(HIGH);
+                POSITION_KNOWN = true;
+                POSITION_REFERENCED = true;
+                MOTION_STATE = MOTION_IDLE;
+            }
+            break;
 
-            //Serial.print("ENCODER_CHANGE ");
-            //Serial.print(ENCODER_CHANGE);
-            //Serial.print(" -> ");
-            //Serial.println(ENCODER_VALUE);
+        case MOTION_MOVING:
+            // never run into an endstop
+            if ( CheckEndStopA() || CheckEndStopB() )
+            {
+                StepEngineStop();
+                MoveQueueClear();
+                MOVE_END_REASON = SERIAL_PROTOCOL_MOVE_ENDSTOP;
+            }
 
-            MOTOR_PULSE_DELAY = RPM2Delay( MOTOR_MIN_SPEED_RPM ) - abs(ENCODER_VALUE * 100);
-            
-            if ( ENCODER_CHANGE < 0 && ENCODER_VALUE_OLD >= 0 && ENCODER_VALUE < 0 )
+            // the move is done, a waiting target in the other direction starts right away
+            if ( !StepEngineIsRunning() )
             {
-                MotorChangeDirection();
+                if ( MOVE_QUEUE_COUNT > 0 ) { MotorMoveTo( MoveQueuePop() ); }
+                else { MotorMoveDone(); }
             }
-            else if ( ENCODER_CHANGE > 0 && ENCODER_VALUE_OLD <= 0 && ENCODER_VALUE > 0 )
+            else { MotorBlendNextMove(); }
+            break;
+
+        case MOTION_REVERSING:
+            if ( CheckEndStopA() || CheckEndStopB() )
             {
-                MotorChangeDirection();
+                StepEngineStop();
+                MoveQueueClear();
+                MOVE_END_REASON = SERIAL_PROTOCOL_MOVE_ENDSTOP;
+                MotorMoveDone();
             }
-            
-            ENCODER_VALUE_OLD = ENCODER_VALUE;
 
-        }
+            // standstill reached, now head for the new target
+            else if ( !StepEngineIsRunning() ) { MotorStartMove(); }
+            break;
 
-        // Step the motor if ENCODER_VALUE is not 0
+        case MOTION_CALIBRATE_TO_B:
+            if ( CheckEndStopB() )
+            {
+                StepEngineStop();
+                CALIBRATION_STEPS = 0;
 
-        if (ENCODER_VALUE != 0)
-        {
-            // cap the delay to MOTOR_MAX_SPEED_RPM
-            // the samller the delay the faster the motor steps
-            if ( MOTOR_PULSE_DELAY < RPM2Delay( MOTOR_MAX_SPEED_RPM ) ) { MOTOR_PULSE_DELAY = RPM2Delay( MOTOR_MAX_SPEED_RPM ); }
-            
-            MotorStep();
+                // Goto End Stop A and record each step until endstop A is triggered
+                MotorCalibrateRun(HIGH, CALIBRATION_ESTIMATE);
+                MOTION_STATE = MOTION_CALIBRATE_TO_A;
+            }
 
-            // TODO: Maybe soft motor direction change? Since we know how far we are away from endstopps, this could be possible
+            // the fast part is over, the rest of the way at calibration speed
+            else if ( !StepEngineIsRunning() ) { MotorCalibrateRun(LOW, 0); }
+            break;
 
-            if ( CheckEndStopA() || CheckEndStopB() )
+        case MOTION_CALIBRATE_TO_A:
+            if ( CheckEndStopA() )
             {
-                MotorChangeDirection();
+                StepEngineStop();
+                CALIBRATION_STEPS += StepEngineGetStepsDone();
+                MotorCalibrateFinish();
             }
-        }
-    }
+            else if ( !StepEngineIsRunning() )
+            {
+                CALIBRATION_STEPS += StepEngineGetStepsDone();
+                MotorCalibrateRun(HIGH, 0);
+            }
+            break;
 
-    // STEP MOTOR MODE aka STEP MODE aka SCHRITT-MODUS
-    // each encoder step is a single motor step
-    else if (MOTOR_MODE == 1)
-    {
-        // Single Motor Step Mode
-        if (ENCODER_CHANGE != 0)
-        {
-            MOTOR_DIRECTION = ENCODER_CHANGE > 0 ? LOW : HIGH;
-            MotorStep();
-        }
+        case MOTION_CALIBRATE_BACK_OFF:
+            if ( !StepEngineIsRunning() )
+            {
+                LOG_INFO("Calibration finished, track steps: %lu", CONFIG.trackSteps);
+
+                // only the bytes that differ from the stored value are written
+                CONFIG_STORE_SAVE(trackSteps);
+                POSITION_KNOWN = true;
+                POSITION_REFERENCED = true;
+                MOTION_STATE = MOTION_IDLE;
+            }
+            break;
     }
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////
-// FUNCTION DEFINITIONS ///////////////////////////////////////////////////////////////////////////////////
 
 /*****************************************************
- * CalculateEEPROMAddressForButton()
- * Caclualtes the address for a certain position in EEPROM
- * every value is an unsigned long
- * position 0 contains the whole track length in steps
- * position 1 to 12 correspondents to the switches 1 to 12 and stores 
- * the motor position in steps
- * 
- * byte buttonID must be a number between 0 and 11 and correspondents to the array position in the buttons Array 
+ * UiTask()
+ * Runs the current state of the user interface
  */
-int CalculateEEPROMAddressForButton( byte buttonID )
+void UiTask()
 {
-    //unsigned int storedTotalTrackSteps = 0;
-    //EEPROM.get(0, storedTotalTrackSteps);
+    PROFILE(PROFILER_UI);
 
-    // add the size of the first value (track length)
-    int result = sizeof(unsigned long);
+    // the position is lost, home as soon as the motor stands on the main screen
+    if ( POSITION_HOMING_NEEDED && MOTION_STATE == MOTION_IDLE && !StepEngineIsRunning() && (UI_STATE == UI_MAIN || UI_STATE == UI_MOVING) )
+    {
+        POSITION_HOMING_NEEDED = false;
+        UiEnterState(UI_HOMING);
+        return;
+    }
 
-    // now add the sizes of the switches before the current one
-    result += buttonID * sizeof(unsigned long);
+    switch ( UI_STATE )
+    {
+        case UI_BOOT:
+            BootScreenUpdate();
+            break;
 
-    return result;
-}
+        case UI_HOMING:
+            if ( MOTION_STATE == MOTION_IDLE ) { UiEnterState(UI_MAIN); }
+            break;
 
+        case UI_MAIN:
+            MainScreenUpdate();
+            break;
 
-/*****************************************************
- * RPM2Delay( int rpm )
- * Calculate the delay value in microseconds we need to use in the MotorStep()
- * function for the the rounds per minute
- * 
- * int rpm - the rounds pe rminute value we are aiming at
- */
-unsigned int RPM2Delay( int rpm )
-{
-    return (60000000 / rpm) / MOTOR_PPR;
-}
+        case UI_MOVING:
+            MovingScreenUpdate();
+            break;
 
-/*****************************************************
- * Delay2RPM( int delayValue )
- * Calculate the rounds per minute for a pulse delay value we use in
- * MotorStep() function
- * 
- * int delayValue - the pulse delay value we want to calculate into rounds per minute
- */
-int Delay2RPM( int delayValue )
-{
-    return (60 / (delayValue / 1000000)) / MOTOR_PPR;
-}
+        case UI_SAVE_POSITION:
+            SavePositionUpdate();
+            break;
 
+        case UI_SETTINGS:
+            MotorSettingsUpdate();
+            break;
 
-/*****************************************************
- * CheckButtons()
- */
-int CheckButtons()
-{
-    for (int i = 0; i < NUM_BUTTONS; i++)
-    {
-        // Update the Bounce instance
-        buttons[i].update();
+        case UI_CALIBRATING:
+            CalibrationUpdate();
+            break;
 
-        // If button has been pressed
-        if (buttons[i].fell())
-        {
-            Serial.print("Button pressed: ");
-            Serial.println(i);
-            BUTTON_PRESSED = i;
-            return i;
-        }
-    }
+        case UI_MESSAGE:
+            if ( millis() - START_TIME >= MESSAGE_DURATION ) { UiEnterState(MESSAGE_NEXT_STATE); }
 
-    return -1;
+            // a button press on the way back to the main screen skips the message
+            // and is handled by the main screen right away
+            else if ( MESSAGE_NEXT_STATE == UI_MAIN && BUTTON_PRESSED >= 0 )
+            {
+                UiEnterState(UI_MAIN);
+                MainScreenUpdate();
+            }
+            break;
+    }
 }
 
 
 /*****************************************************
- * CheckButton(byte id)
- * returns true if the button with the id is pressed
+ * UiEnterState( UiState state )
+ * Switches the user interface to another state and
+ * draws the screen of that state
  */
-bool CheckButton(byte id)
+void UiEnterState( UiState state )
 {
-    Serial.print("CheckButton() ");
-    Serial.println(id);
-
-    buttons[id].update();
+    UI_STATE = state;
+    START_TIME = millis();
 
-    if (buttons[id].fell())
+    switch ( state )
     {
-        Serial.println("true");
-        BUTTON_PRESSED = id;
-        return true;
-    }
-
-    Serial.println("false");
-    return false;
-}
+        case UI_BOOT:
+            BOOT_DOTS = 0;
+            break;
 
+        case UI_HOMING:
+            DisplayClear();
+            DisplayMessage(20, 0, UI_TEXT(UI_TEXT_LOKLIFT));
+            DisplayMessage(10, 10, UI_TEXT(UI_TEXT_CONTROLLER));
+            DisplayMessage(0, 30, UI_TEXT(UI_TEXT_HOMING));
+            MotorMoveToEndStopA();
+            break;
 
-/*****************************************************
- *  CheckEndStopA()
- */
-bool CheckEndStopA()
-{
-    endStopA.update();
+        case UI_MAIN:
+            PrepareForMainLoop();
+            break;
 
-    if (endStopA.fell())
-    {
-        Serial.println("endStopA betaetigt");
-        return true;
-    }
+        case UI_MOVING:
+            DrawMovingScreen();
+            break;
 
-    return false;
-}
+        case UI_SAVE_POSITION:
+            SavePosition();
+            break;
 
+        case UI_SETTINGS:
+            MotorSettings();
+            break;
 
-/*****************************************************
- *  CheckEndStopB()
- */
-bool CheckEndStopB()
-{
-    endStopB.update();
+        case UI_CALIBRATING:
+            MotorCalibrateEndStops();
+            break;
 
-    if (endStopB.fell())
-    {
-        Serial.println("endStopB betaetigt");
-        return true;
+        case UI_MESSAGE:
+            break;
     }
-
-    return false;
 }
 
 
 /*****************************************************
- * EncoderReset()
- * Resets the encoder position to zero
+ * UiShowMessage( unsigned long duration, UiState nextState )
+ * Keeps the message that has just been drawn on the display
+ * for duration milliseconds and enters nextState afterwards
  */
-void EncoderReset()
+void UiShowMessage( unsigned long duration, UiState nextState )
 {
-    Serial.println("EncoderReset()");
-    rotaryEncoder.reset();
-    ENCODER_CHANGE = 0;
-    ENCODER_VALUE = 0;
-    ENCODER_VALUE_OLD = 0;
+    MESSAGE_DURATION = duration;
+    MESSAGE_NEXT_STATE = nextState;
+    UiEnterState(UI_MESSAGE);
 }
 
 
 /*****************************************************
- * LoadEEPROMData()
- * Loads the data from EEPROM to the appropriate variables
+ * BootScreenUpdate()
+ * Waits BOOT_MENU_TIMEOUT milliseconds on the boot screen for a
+ * button press that enters a configuration mode, any other button
+ * or a turn of the knob ends the wait early
  */
-void LoadEEPROMData()
+void BootScreenUpdate()
 {
-    Serial.println("LoadEEPROMData()");
+    // if button 12 (red button) is pressed on startup then start calibration
+    if (BUTTON_PRESSED == 12)
+    {
+        UiEnterState(UI_CALIBRATING);
+        return;
+    }
 
-    int address = 0;
+    // if button 13 (rotary knob) is pressed on startup then start motor setup
+    if (BUTTON_PRESSED == 13)
+    {
+        SETTINGS_RETURN_STATE = UI_HOMING;
+        UiEnterState(UI_SETTINGS);
+        return;
+    }
 
-    // TOTAL_TRACK_STEPS
-    EEPROM.get(address, TOTAL_TRACK_STEPS);
-    Serial.print("    TOTAL_TRACK_STEPS: ");
-    Serial.print(TOTAL_TRACK_STEPS);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(TOTAL_TRACK_STEPS);
+    // any other button or a turn of the knob skips the rest of the wait
+    if ( BUTTON_PRESSED >= 0 || ENCODER_CHANGE != 0 )
+    {
+        BootFinish();
+        return;
+    }
 
-    // TARGET_POSITIONS
-    for (size_t i = 0; i < 12; i++)
+    unsigned long elapsed = millis() - START_TIME;
+    if ( elapsed >= BOOT_MENU_TIMEOUT )
     {
-        EEPROM.get(address, TARGET_POSITIONS[i]);
-        Serial.print("    TARGET_POSITIONS[");
-        Serial.print(i);
-        Serial.print("]: ");
-        Serial.print(TARGET_POSITIONS[i]);
-        Serial.print(" | ");
-        Serial.println(address);
-        address += sizeof(TARGET_POSITIONS[i]);
+        BootFinish();
+        return;
     }
 
-    // MOTOR_MIN_SPEED_RPM
-    EEPROM.get(address, MOTOR_MIN_SPEED_RPM);
-    Serial.print("    MOTOR_MIN_SPEED_RPM: ");
-    Serial.print(MOTOR_MIN_SPEED_RPM);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_MIN_SPEED_RPM);
-
-    // MOTOR_MAX_SPEED_RPM
-    EEPROM.get(address, MOTOR_MAX_SPEED_RPM);
-    Serial.print("    MOTOR_MAX_SPEED_RPM: ");
-    Serial.print(MOTOR_MAX_SPEED_RPM);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_MAX_SPEED_RPM);
-
-    // MOTOR_CALIBRATION_SPEED_RPM
-    EEPROM.get(address, MOTOR_CALIBRATION_SPEED_RPM);
-    Serial.print("    MOTOR_CALIBRATION_SPEED_RPM: ");
-    Serial.print(MOTOR_CALIBRATION_SPEED_RPM);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_CALIBRATION_SPEED_RPM);
-
-    // ACCEL_STEPS
-    EEPROM.get(address, ACCEL_STEPS);
-    Serial.print("    ACCEL_STEPS: ");
-    Serial.print(ACCEL_STEPS);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(ACCEL_STEPS);
-
-    // MOTOR_PPR
-    EEPROM.get(address, MOTOR_PPR);
-    Serial.print("    MOTOR_PPR: ");
-    Serial.print(MOTOR_PPR);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_PPR);
+    // one more dot every second, only redraw if the number has changed
+    byte dots = elapsed / 1000 + 1;
+    if ( dots != BOOT_DOTS )
+    {
+        // the last dots of the string in flash
+        const char *allDots = PSTR(".....");
+        BOOT_DOTS = dots;
+        DisplayMessage(40, 25, (const __FlashStringHelper *)(allDots + 5 - dots));
+    }
 }
 
 
 /*****************************************************
- * MotorChangeDirection()
- * Changes the direction of the motor
+ * BootFinish()
+ * Ends the boot screen, the motor only moves to endstop A
+ * if the journal has no position the motor has rested at
+ * when the power went off
  */
-void MotorChangeDirection()
+void BootFinish()
 {
-    //Serial.println("MotorChangeDirection()");
-    MOTOR_DIRECTION = !MOTOR_DIRECTION;
+    unsigned long position;
+
+    if ( PositionJournalGetRestPosition(&position) && position <= CONFIG.trackSteps )
+    {
+        LOG_INFO("Position %lu restored, homing skipped", position);
+
+        StepEngineSetPosition(position);
+        StepEngineSetDirection(HIGH);
+        POSITION_KNOWN = true;
+        POSITION_REFERENCED = true;
+        POSITION_LAST = position;
+        UiEnterState(UI_MAIN);
+        return;
+    }
+
+    UiEnterState(UI_HOMING);
 }
 
 
 /*****************************************************
- *  MotorCalibrateEndStops()
+ * MainScreenUpdate()
+ * Checks the buttons on the main screen and runs the motor modes
  */
-void MotorCalibrateEndStops()
+void MainScreenUpdate()
 {
-    Serial.println("MotorCalibrateEndStops()");
-
-    DisplayClear();
-    DisplayMessage(0, 0, "Strecke messen");
-
-    // read storedTotalTrackSteps value from EEPROM
-    unsigned int storedTotalTrackSteps = 0;
-    EEPROM.get(0, storedTotalTrackSteps);
+    int button = BUTTON_PRESSED;
+    if ( ENCODER_BUTTON == Button::DoubleClicked ) { button = MAIN_SCREEN_DOUBLE_CLICK; }
 
-    bool hasFirstEndStopTriggered = false;
-    bool hasSecondEndStopTriggered = false;
+    // a button never stops the motor of drive mode dead, it brakes along
+    // the ramp like at the soft limit and the button waits for standstill
+    if ( button >= 0 && StepEngineIsRunning() )
+    {
+        MAIN_SCREEN_PENDING = button;
+        EncoderReset();
+        StepEngineSetTarget( StepEngineGetPosition() );
+    }
 
-    // set the speed of the motor to calibrationSpeed
-    int calibrationMotorPulseDelay = RPM2Delay( MOTOR_CALIBRATION_SPEED_RPM );
-    
-    // set direction to move to EndStop B
-    MOTOR_DIRECTION = LOW;
-
-    // Goto first End Stop B
-    int stepsDone = 0;
-    while (hasFirstEndStopTriggered == false)
+    if ( MAIN_SCREEN_PENDING >= 0 )
     {
-        // add accleration
-        MOTOR_PULSE_DELAY = LerpLinear(15000, calibrationMotorPulseDelay, stepsDone);
-        MotorStep();
-        stepsDone++;
-
-        if ( CheckEndStopB() == true )
+        if ( StepEngineIsRunning() )
         {
-            MotorChangeDirection();
-            hasFirstEndStopTriggered = true;
-            TOTAL_TRACK_STEPS = 0;
-            DisplayMessage(0, 10, "Endstop B");
-
+            if ( millis() - DISPLAY_REFRESH_TIME >= DISPLAY_REFRESH_PERIOD ) { DrawMainScreenValues(); }
+            return;
         }
+
+        button = MAIN_SCREEN_PENDING;
+        MAIN_SCREEN_PENDING = -1;
     }
 
-    // Goto End Stop A and record each step until endstop A is triggered
-    stepsDone = 0;
-    while (hasSecondEndStopTriggered == false)
+    // if button 1 to 12 is pressed
+    // drive motor to position
+    if ( button >= 0 && button <= 11 )
     {
-        // add accleration
-        MOTOR_PULSE_DELAY = LerpLinear(15000, calibrationMotorPulseDelay, stepsDone);
-        MotorStep();
-        stepsDone++;
-
-        TOTAL_TRACK_STEPS++;
+        if ( MotorMoveToButton( button ) ) { UiEnterState(UI_MOVING); }
 
-        if ( CheckEndStopA() == true )
+        // display an error message if target is not in
+        // total track range
+        else if ( CONFIG.positions[button] > CONFIG.trackSteps )
         {
-            MotorChangeDirection();
-            hasSecondEndStopTriggered = true;
-            DisplayMessage(0, 20, "Endstop A");
-            DisplayMessage(0, 30, String(TOTAL_TRACK_STEPS));
+            DisplayClear();
+            DisplayMessage(0,0, UI_TEXT(UI_TEXT_OUT_OF_RANGE));
+            UiShowMessage(4000, UI_MAIN);
         }
+        return;
     }
 
-    // Now motor is at position 0
-    // from now on we need to track every step movement in CURRENT_STEP_POSITION variable
-    // this handles MotorStep(), so only use MotorStep() from now on
-    CURRENT_STEP_POSITION = 0;
-
-    // move back a little 10% of the TOTAL_TRACK_STEPS
-    stepsDone = 0;
-    unsigned int tenPercentSteps = TOTAL_TRACK_STEPS / 100 * 10;
-    for (size_t i = 0; i < tenPercentSteps; i++)
+    // check for button 12 to initiate saving curent position
+    else if (button == 12)
     {
-        // add accleration
-        MOTOR_PULSE_DELAY = LerpLinear(15000, calibrationMotorPulseDelay, stepsDone);
-        MotorStep();
-        stepsDone++;
+        UiEnterState(UI_SAVE_POSITION);
+        return;
     }
 
-    Serial.println("Calibration finished");
-    Serial.print("Total track steps:");
-    Serial.println(TOTAL_TRACK_STEPS);
+    // check for rotay encoder knob switch press
+    // to switch motor mode
+    else if (button == 13)
+    {
+        MotorModeSwitch();
+        return;
+    }
 
-    // if new value differs from stored value then save it to EEPROM
-    if (storedTotalTrackSteps != TOTAL_TRACK_STEPS)
+    // check for double click on rotary encoder knob
+    // if double click detected, opens the MotorSettings menu
+    if ( button == MAIN_SCREEN_DOUBLE_CLICK )
     {
-        EEPROM.put(0, TOTAL_TRACK_STEPS);
+        LOG_DEBUG("Encoder double clicked");
+        SETTINGS_RETURN_STATE = UI_MAIN;
+        UiEnterState(UI_SETTINGS);
+        return;
     }
 
-    // debug dump EEPROM to console
-    LoadEEPROMData();
+    MotorModeUpdate();
 
-    DisplayMessage(0, 40, "Gespeichert");
-    delay(2000);
+    if ( millis() - DISPLAY_REFRESH_TIME >= DISPLAY_REFRESH_PERIOD ) { DrawMainScreenValues(); }
 }
 
 
 /*****************************************************
- * MotorModeSwitch()
- * switches through the different motor modes
+ * DrawMainScreenValues()
+ * Shows the current position and, while the motor runs in
+ * drive mode or step mode, its speed on the main screen
  */
-void MotorModeSwitch()
+void DrawMainScreenValues()
 {
-    MOTOR_MODE++;
-    if (MOTOR_MODE >= 2)
-    {
-        MOTOR_MODE = 0;
-    }
+    DISPLAY_REFRESH_TIME = millis();
 
-    DisplayClear();
+    char line[15];
+    unsigned long pulseDelay = StepEngineGetInterval();
 
-    if ( MOTOR_MODE == 0 )
-    {
-        DisplayMessage( 0,0, "Lauf-Modus");
-        MOTOR_DIRECTION = HIGH;
-    }
-    else if ( MOTOR_MODE == 1 )
+    // the padding overwrites the rest of a longer old value
+    snprintf_P(line, sizeof(line), PSTR("%-14lu"), StepEngineGetPosition());
+    DisplayMessage(0, 30, line);
+
+    if ( pulseDelay > 0 ) { snprintf_P(line, sizeof(line), UiTextGet(UI_TEXT_SPEED), Delay2RPM( pulseDelay )); }
+    else { snprintf_P(line, sizeof(line), PSTR("%-14s"), ""); }
+    DisplayMessage(0, 40, line);
+}
+
+
+/*****************************************************
+ * MovingScreenUpdate()
+ * Waits for the end of the move and its queued targets
+ * while the motor is moving:
+ * button 1 to 12 queues another target
+ * button 13 (rotary knob) skips to the next queued target
+ * button 12 (red button) stops the motor and drops the queue
+ */
+void MovingScreenUpdate()
+{
+    if ( MOTION_STATE == MOTION_IDLE )
     {
-        DisplayMessage( 0,0, "Schritt-Modus");
+        DrawMovingValues();
+        display.fillRect(0, 40, DISPLAY_BUFFER_WIDTH, 8, WHITE);
+        DisplayMessage(0,40, UI_TEXT(UI_TEXT_DONE));
+        UiShowMessage(1000, UI_MAIN);
+        return;
     }
 
-    Serial.print("MOTOR_MODE: ");
-    Serial.println(MOTOR_MODE);
-
-    delay(1500);
+    if ( BUTTON_PRESSED >= 0 && BUTTON_PRESSED <= 11 ) { MotorMoveToButton( BUTTON_PRESSED ); }
+    else if ( BUTTON_PRESSED == 12 ) { MotorStopMove(); }
+    else if ( BUTTON_PRESSED == 13 ) { MotorSkipMove(); }
 
-    // back to main loop
-    PrepareForMainLoop();
+    // redraw the screen as soon as the target or the queue has changed,
+    // the live values are updated at a fixed rate
+    if ( MOVE_TARGET_POSITION != MOVING_SCREEN_TARGET || MOVE_QUEUE_COUNT != MOVING_SCREEN_QUEUE )
+    {
+        DrawMovingScreen();
+    }
+    else if ( millis() - DISPLAY_REFRESH_TIME >= DISPLAY_REFRESH_PERIOD ) { DrawMovingValues(); }
 }
 
+
 /*****************************************************
- * DrawMotorSettings( byte selectedCol, byte selectedRow )
- * 
- * Draw the motor settings menu
- * selectedCol is the currently selected column of the menu
- * selectedRow is the currently selected row of the menu
- * With these two values we can select a cell in the menu
- * that can be drawn inverted
+ * DrawMovingScreen()
+ * Shows the target of the current move and the live values
  */
-void DrawMotorSettings( byte selectedCol, byte selectedRow )
+void DrawMovingScreen()
 {
-    DisplayClear();
+    MOVING_SCREEN_TARGET = MOVE_TARGET_POSITION;
+    MOVING_SCREEN_QUEUE = MOVE_QUEUE_COUNT;
 
-    boolean selection[2][5] = {
-        {false, false, false, false, false},
-        {false, false, false, false, false}
-    };
+    char line[15];
+    int slot = MotorTargetSlot( MOVE_TARGET_POSITION );
 
-    selection[selectedCol][selectedRow] = true;
-    
-    display.drawChar(78, 40, 0x1A, BLACK, WHITE, 1);
+    // the host may send targets that are not stored on a button
+    if ( slot >= 0 ) { snprintf_P(line, sizeof(line), UiTextGet(UI_TEXT_TARGET_SLOT), slot + 1); }
+    else { snprintf_P(line, sizeof(line), UiTextGet(UI_TEXT_TARGET_POSITION), MOVE_TARGET_POSITION); }
 
-    DisplayMessage(0, 0, "MaxRPM:", selection[0][0]);
-    DisplayMessage(0, 10, "MinRPM:", selection[0][1]);
-    DisplayMessage(0, 20, "CalRPM:", selection[0][2]);
-    DisplayMessage(0, 30, "AccStp:", selection[0][3]);
-    DisplayMessage(0, 40, "MotPPR:", selection[0][4]);
+    DisplayClear();
+    DisplayMessage(0,0, line);
+    display.drawRect(0, 20, DISPLAY_BUFFER_WIDTH, 7, BLACK);
 
-    DisplayMessage(45, 0, String(MOTOR_MAX_SPEED_RPM), selection[1][0]);
-    DisplayMessage(45, 10, String(MOTOR_MIN_SPEED_RPM), selection[1][1]);
-    DisplayMessage(45, 20, String(MOTOR_CALIBRATION_SPEED_RPM), selection[1][2]);
-    DisplayMessage(45, 30, String(ACCEL_STEPS), selection[1][3]);
-    DisplayMessage(45, 40, String(MOTOR_PPR), selection[1][4]);
+    DrawMovingValues();
 }
 
+
 /*****************************************************
- * MotorSettings()
- * Setup some values for the motor settings controlled 
- * with the rotary encoder
+ * DrawMovingValues()
+ * Shows the position, the progress, the speed and the time
+ * until the current target is reached on the moving screen
  */
-void MotorSettings()
+void DrawMovingValues()
 {
-    byte selectedCol = 0;
-    byte selectedRow = 0;
-    EncoderReset();
-    rotaryEncoder.setAccelerationEnabled(false);
-
-    // store these values for later camparisons to check
-    // if writing to EEPROM is neccessery at all
-    unsigned int oldMotorMinSpeedRPM            = MOTOR_MIN_SPEED_RPM;
-    unsigned int oldMotorMaxSpeedRPM            = MOTOR_MAX_SPEED_RPM;
-    unsigned int oldMotorCalibrationSpeedRPM    = MOTOR_CALIBRATION_SPEED_RPM;
-    unsigned int oldAccelSteps                  = ACCEL_STEPS;
-    unsigned int oldMotorPPR                    = MOTOR_PPR;
+    DISPLAY_REFRESH_TIME = millis();
+
+    char line[15];
+    unsigned long position = StepEngineGetPosition();
+    unsigned long pulseDelay = StepEngineGetInterval();
+
+    // the padding overwrites the rest of a longer old value
+    snprintf_P(line, sizeof(line), UiTextGet(UI_TEXT_POSITION_VALUE), position);
+    DisplayMessage(0,10, line);
+
+    // the bar shows the part of the way from the start of the move that is done,
+    // 65535 is the whole bar
+    unsigned long distance = MOVE_TARGET_POSITION > MOVE_START_POSITION ? MOVE_TARGET_POSITION - MOVE_START_POSITION : MOVE_START_POSITION - MOVE_TARGET_POSITION;
+    unsigned long left = MOVE_TARGET_POSITION > position ? MOVE_TARGET_POSITION - position : position - MOVE_TARGET_POSITION;
+    unsigned int done = left < distance ? 0xFFFF - MotionMathFraction16( left, distance ) : 0;
+    if ( MOTION_STATE == MOTION_IDLE ) { done = 0xFFFF; }
+
+    byte barWidth = ((unsigned long)done * (DISPLAY_BUFFER_WIDTH - 2) + 0x8000) >> 16;
+    display.fillRect(1, 21, barWidth, 5, BLACK);
+    display.fillRect(1 + barWidth, 21, DISPLAY_BUFFER_WIDTH - 2 - barWidth, 5, WHITE);
+
+    snprintf_P(line, sizeof(line), UiTextGet(UI_TEXT_SPEED), pulseDelay > 0 ? Delay2RPM( pulseDelay ) : 0);
+    DisplayMessage(0,30, line);
+
+    // the queued targets are not part of the estimate
+    unsigned long seconds = (MotorEstimateArrival() + 999) / 1000;
+    if ( MOVE_QUEUE_COUNT > 0 ) { snprintf_P(line, sizeof(line), PSTR("%3lu:%02lu  +%u    "), seconds / 60, seconds % 60, MOVE_QUEUE_COUNT); }
+    else { snprintf_P(line, sizeof(line), PSTR("%3lu:%02lu        "), seconds / 60, seconds % 60); }
+    DisplayMessage(0,40, line);
+}
 
-    // Draw the menu
-    DrawMotorSettings( selectedCol, selectedRow );
 
-    while( true )
+/*****************************************************
+ * MotorModeUpdate()
+ * Drives the motor with the rotary encoder in the current motor mode
+ */
+void MotorModeUpdate()
+{
+    // CONTINOUS MOTOR MODE aka DRIVE MODE aka LAUF-MODUS
+    // rotary encoder controls the speed, the side of zero the direction
+    if (MOTOR_MODE == 0)
     {
-
-        // First column is selected
-        // here we can select the row with the encoder
-        if ( selectedCol == 0 )
+        if (ENCODER_CHANGE != 0)
         {
-            ENCODER_CHANGE = rotaryEncoder.getIncrement();
             ENCODER_VALUE = rotaryEncoder.getAccumulate();
 
-            if ( ENCODER_CHANGE != 0 )
-            {
-                Serial.print("ENCODER_CHANGE: ");
-                Serial.println(ENCODER_CHANGE);
-
-                if (selectedRow == 0 && ENCODER_CHANGE < 0){ selectedRow = 5;}
-                selectedRow = selectedRow + ENCODER_CHANGE;
-                if (selectedRow > 4){ selectedRow = 0;}
+            // cap the delay to CONFIG.maxSpeedRpm
+            // the samller the delay the faster the motor steps
+            long pulseDelay = (long)RPM2Delay( CONFIG.minSpeedRpm ) - abs( (long)ENCODER_VALUE * 100 );
+            long maxSpeedPulseDelay = RPM2Delay( CONFIG.maxSpeedRpm );
+            MOTOR_PULSE_DELAY = pulseDelay < maxSpeedPulseDelay ? maxSpeedPulseDelay : pulseDelay;
 
-                Serial.print("selectedRow: ");
-                Serial.println(selectedRow);
+            ENCODER_VALUE_OLD = ENCODER_VALUE;
 
-                DrawMotorSettings( selectedCol, selectedRow );
-            }
+            // the StepEngine changes the speed along the ramp
+            if ( StepEngineIsRunning() ) { StepEngineSetCruiseInterval(MOTOR_PULSE_DELAY); }
         }
 
-        // Second column is selected
-        // here we can adjust the selected value
-        else if ( selectedCol == 1 )
+        MotorDriveUpdate();
+    }
+
+    // STEP MOTOR MODE aka STEP MODE aka SCHRITT-MODUS
+    // each encoder step is a single motor step
+    else if (MOTOR_MODE == 1)
+    {
+        // Single Motor Step Mode
+        if (ENCODER_CHANGE != 0)
         {
-            ENCODER_CHANGE = rotaryEncoder.getIncrement();
-            //ENCODER_VALUE = rotaryEncoder.getAccumulate();
+            StepEngineSetDirection( ENCODER_CHANGE > 0 ? LOW : HIGH );
 
-            if ( ENCODER_CHANGE != 0 )
-            {
-                // calculate a value based on acceleration (= ENCODER_CHANGE)
-                // the higher ENCODER_CHANGE is, ther more gets added to the value
-                int16_t calcValueChange = ENCODER_CHANGE * ENCODER_CHANGE;
-                if (ENCODER_CHANGE < 0){ calcValueChange = -calcValueChange; }
+            // the steps of a session may go anywhere, only the first one writes the journal
+            PositionJournalSetMoving( 0 );
+            StepEngineStart(1, MOTOR_PULSE_DELAY);
+        }
+    }
+}
 
-                if ( selectedRow == 0 ){ 
-                    MOTOR_MAX_SPEED_RPM = MOTOR_MAX_SPEED_RPM + calcValueChange;
-                    MOTOR_MAX_SPEED_RPM = constrain(MOTOR_MAX_SPEED_RPM, 5, 1000);
 
-                }
-                else if ( selectedRow == 1 ){ 
-                    MOTOR_MIN_SPEED_RPM = MOTOR_MIN_SPEED_RPM + calcValueChange;
-                    MOTOR_MIN_SPEED_RPM = constrain(MOTOR_MIN_SPEED_RPM, 5, 1000);
-                }
-                else if ( selectedRow == 2 ){ 
-                    MOTOR_CALIBRATION_SPEED_RPM = MOTOR_CALIBRATION_SPEED_RPM + calcValueChange;
-                    //MOTOR_CALIBRATION_SPEED_RPM = constrain(MOTOR_CALIBRATION_SPEED_RPM, 5, 1000);
-                    if ( MOTOR_CALIBRATION_SPEED_RPM < 5 ){ MOTOR_CALIBRATION_SPEED_RPM = 1000; }
-                    else if ( MOTOR_CALIBRATION_SPEED_RPM > 1000 ){ MOTOR_CALIBRATION_SPEED_RPM = 5; }
-                }
-                else if ( selectedRow == 3 ){ 
-                    ACCEL_STEPS = ACCEL_STEPS + calcValueChange;
-                    ACCEL_STEPS = constrain(ACCEL_STEPS, 0, 2000);
-                }
-                else if ( selectedRow == 4 ){ 
-                    MOTOR_PPR = MOTOR_PPR + calcValueChange;
-                    MOTOR_PPR = constrain(MOTOR_PPR, 100, 2000);
-                }
+/*****************************************************
+ * MotorDriveUpdate()
+ * Runs the motor in drive mode in the direction of the encoder. Every
+ * drive is a profiled move that ends at the soft limit, so the StepEngine
+ * brakes along the ramp from whatever speed it has and stops at the limit.
+ * Turning the encoder back to zero or to the other side brakes the motor,
+ * it starts again in the other direction from standstill.
+ */
+void MotorDriveUpdate()
+{
+    // endstops are only reached if the soft limits are switched off or
+    // the track has not been measured, stop driving then
+    if ( CheckEndStopA() || CheckEndStopB() )
+    {
+        EncoderReset();
+        return;
+    }
 
-                DrawMotorSettings( selectedCol, selectedRow );
-            }
-        }
+    bool running = StepEngineIsRunning();
 
-        // Button Checks
-        CheckButtons();
+    if ( ENCODER_VALUE == 0 )
+    {
+        // the current position is too close to reach, so the engine brakes along the ramp
+        if ( running ) { StepEngineSetTarget( StepEngineGetPosition() ); }
+        return;
+    }
 
-        // check for rotay encoder knob switch press
-        if (BUTTON_PRESSED == 13)
-        {
-            selectedCol++;
-            if ( selectedCol > 1 ){ selectedCol = 0; }
+    // same directions as in step mode: encoder up = position increases
+    bool direction = ENCODER_VALUE > 0 ? LOW : HIGH;
+    unsigned long limit = MotorDriveLimit( direction );
 
-            if (selectedCol == 0) { rotaryEncoder.setAccelerationEnabled(false); }
-            else if (selectedCol == 1) { rotaryEncoder.setAccelerationEnabled(true); }
+    if ( running )
+    {
+        if ( direction == StepEngineGetDirection() ) { StepEngineSetTarget( limit ); }
+        else { StepEngineSetTarget( StepEngineGetPosition() ); }
+        return;
+    }
 
-            Serial.print("selectedCol: ");
-            Serial.println(selectedCol);
+    // at the soft limit only the other direction is possible
+    unsigned long position = StepEngineGetPosition();
+    if ( direction == LOW && position >= limit ) { return; }
+    if ( direction == HIGH && position <= limit ) { return; }
 
-            BUTTON_PRESSED = -1;
+    StepEngineSetDirection( direction );
+    PositionJournalSetMoving( limit );
+    StepEngineStartProfile( direction == LOW ? limit - position : position - limit, MOTOR_PULSE_DELAY );
+}
 
-            EncoderReset();
-            DrawMotorSettings( selectedCol, selectedRow );
-        }
 
-        // check for button 12 (red button) to initiate saving end exit motor settings
-        else if (BUTTON_PRESSED == 12)
-        {
-            BUTTON_PRESSED = -1;
-
-            // only if any of the values haave changed write to EEPROM
-            if ( 
-                oldMotorMinSpeedRPM != MOTOR_MIN_SPEED_RPM || 
-                oldMotorMaxSpeedRPM != MOTOR_MAX_SPEED_RPM || 
-                oldMotorCalibrationSpeedRPM != MOTOR_CALIBRATION_SPEED_RPM ||
-                oldAccelSteps != ACCEL_STEPS ||
-                oldMotorPPR != MOTOR_PPR
-            )
-            {
-                SaveMotorSettings();
-            }
+/*****************************************************
+ * MotorDriveLimit( bool direction )
+ * returns the soft limit in the direction, CONFIG.softLimitSteps
+ * inside of the endstop, or MOTOR_DRIVE_NO_LIMIT towards endstop B
+ * if the track has not been measured or is too short for the limits
+ */
+unsigned long MotorDriveLimit( bool direction )
+{
+    // endstop A is at position 0
+    if ( direction == HIGH ) { return CONFIG.softLimitSteps; }
 
-            EncoderReset();
-            rotaryEncoder.setAccelerationEnabled(true);
-            break;
-        }
+    // without a measured track only endstop B limits the drive
+    if ( CONFIG.trackSteps == 0xFFFFFFFF ) { return MOTOR_DRIVE_NO_LIMIT; }
+    if ( CONFIG.trackSteps <= 2UL * CONFIG.softLimitSteps ) { return MOTOR_DRIVE_NO_LIMIT; }
 
-    }
+    return CONFIG.trackSteps - CONFIG.softLimitSteps;
 }
 
 
 /*****************************************************
- * MotorMoveTo( unsigned long targetPosition )
- * moves the motor until target position is met
+ * MotorEstimateArrival()
+ * returns the milliseconds until the current move reaches its target
+ *
+ * The motor keeps its current speed until it has to brake and needs
+ * the average of its current and its start pulse delay for each step
+ * of the braking ramp. While it turns around there is no estimate.
  */
-void MotorMoveTo( unsigned long targetPosition )
+unsigned long MotorEstimateArrival()
 {
-    Serial.print("MotorMoveTo() targetPosition: ");
-    Serial.println(targetPosition);
+    unsigned long pulseDelay = StepEngineGetInterval();
+    if ( MOTION_STATE != MOTION_MOVING || pulseDelay == 0 ) { return 0; }
 
-    DisplayClear();
-    DisplayMessage(0,0, "Bahn frei!");
-    DisplayMessage(0,20, "Ziel: ");
-    DisplayMessage(0,30, String(targetPosition));
+    unsigned long position = StepEngineGetPosition();
+    unsigned long left = MOVE_TARGET_POSITION > position ? MOVE_TARGET_POSITION - position : position - MOVE_TARGET_POSITION;
+
+    // the ramp step of the current speed is the number of steps it takes to brake
+    unsigned long brakeSteps = RampTableFindStep( pulseDelay );
+    if ( brakeSteps > left ) { brakeSteps = left; }
+
+    return MotionMathTravelTime( left - brakeSteps, pulseDelay ) + MotionMathTravelTime( brakeSteps, (pulseDelay + RampTableLookup(0)) / 2 );
+}
 
-    // cancel if target position is 0 or 4294967295 which is
-    // the max value for unsigned long
-    if ( targetPosition == 0 || targetPosition == 4294967295 )
-    {
-        Serial.println("CANCELLED: it seems no position has been saved to the last pressed button, yet.");
-        return;
-    } 
 
-    unsigned long stepsNeeded = abs( (long)CURRENT_STEP_POSITION - (long)targetPosition );
-    unsigned long stepsDone = 0;
-    unsigned long stepsDoneA = 0;
-    unsigned long stepsDoneB = 0;
-    unsigned long stepsLeft = stepsNeeded;
-    bool isDecelarating = false;
-    
-    unsigned int accelerationSteps = ACCEL_STEPS;
-    if ( accelerationSteps * 2 > stepsNeeded )
+/*****************************************************
+ * CalibrationUpdate()
+ * Shows the progress of the calibration as soon as the
+ * motion sequence has reached its next phase
+ */
+void CalibrationUpdate()
+{
+    if ( MOTION_STATE == MOTION_STATE_SHOWN ) { return; }
+    MOTION_STATE_SHOWN = MOTION_STATE;
+
+    if ( MOTION_STATE == MOTION_CALIBRATE_TO_A )
     {
-        accelerationSteps = round((float)stepsNeeded/2.0);
+        // the number of the measurement that is running
+        DisplayMessage(0, 10, UI_TEXT(UI_TEXT_ENDSTOP_B));
+        DisplayNumber(60, 10, CALIBRATION_RUN + 1);
+        DisplayMessage(66, 10, F("/"));
+        DisplayNumber(72, 10, CALIBRATION_RUNS);
     }
-
-    // set motor speed
-    unsigned int maxMotorPulseDelay      = RPM2Delay( MOTOR_MAX_SPEED_RPM );
-    unsigned int startMotorPulseDelay    = 15000;    // the starting speed delay, should be quite high to start slow (should this be adjustable? EEPROM candidate?)
-    
-    // the delay decrease per step during accellaration phase
-    //unsigned int accelDelay     = abs(startMotorPulseDelay - maxMotorPulseDelay)/ACCEL_STEPS;
-
-    // Serial.print("stepsNeeded: ");
-    // Serial.println(stepsNeeded);
-    // Serial.print("maxMotorPulseDelay: ");
-    // Serial.println(maxMotorPulseDelay);
-    // Serial.print("minMotorPulseDelay: ");
-    // Serial.println(minMotorPulseDelay);
-
-    // move motor as long as target is not reached
-    while( CURRENT_STEP_POSITION != targetPosition )
+    else if ( MOTION_STATE == MOTION_CALIBRATE_BACK_OFF )
     {
-        // ACCELERATION PHASE
-        if ( stepsDone <= accelerationSteps && isDecelarating == false )
-        {
-            MOTOR_PULSE_DELAY = LerpLinear(startMotorPulseDelay, maxMotorPulseDelay, stepsDoneA);
+        DisplayMessage(0, 20, UI_TEXT(UI_TEXT_ENDSTOP_A));
+        DisplayNumber(0, 30, CONFIG.trackSteps);
+    }
+    else if ( MOTION_STATE == MOTION_IDLE )
+    {
+        DisplayMessage(0, 40, UI_TEXT(UI_TEXT_SAVED));
+        UiShowMessage(2000, UI_HOMING);
+    }
+}
 
-            // always cap the max motor speed delay to maxMotorPulseDelay
-            // the smaller the delay, the faster the motor steps, that is why we use < (not >)
-            if ( MOTOR_PULSE_DELAY < maxMotorPulseDelay ) { MOTOR_PULSE_DELAY = maxMotorPulseDelay; }
-            
-            stepsDoneA++;
-        }
 
-        // DECELERATION PHASE
-        else if ( stepsLeft <= accelerationSteps )
-        {
-            if ( isDecelarating == false )
-            {
-                stepsDoneB = accelerationSteps;
-                isDecelarating = true;
-            }
+/*****************************************************
+ * RPM2Delay( unsigned int rpm )
+ * Calculate the delay value in microseconds we need to hand to the StepEngine
+ * for the the rounds per minute
+ * 
+ * unsigned int rpm - the rounds pe rminute value we are aiming at
+ */
+unsigned long RPM2Delay( unsigned int rpm )
+{
+    return MotionMathRPM2Delay( rpm, CONFIG.motorPpr );
+}
 
-            MOTOR_PULSE_DELAY = LerpLinear(startMotorPulseDelay, maxMotorPulseDelay, stepsDoneB);
-            if ( MOTOR_PULSE_DELAY > startMotorPulseDelay ) { MOTOR_PULSE_DELAY = startMotorPulseDelay; }
-            stepsDoneB--;
-        }
+/*****************************************************
+ * Delay2RPM( unsigned long delayValue )
+ * Calculate the rounds per minute for a pulse delay value we hand
+ * to the StepEngine
+ * 
+ * unsigned long delayValue - the pulse delay value we want to calculate into rounds per minute
+ */
+unsigned int Delay2RPM( unsigned long delayValue )
+{
+    return MotionMathDelay2RPM( delayValue, CONFIG.motorPpr );
+}
 
-        // set the correct direction to reach the target position
-        MOTOR_DIRECTION = CURRENT_STEP_POSITION < targetPosition ? LOW : HIGH;
 
-        MotorStep();
-        stepsDone++;
-        stepsLeft--;
+/*****************************************************
+ * CheckButtons()
+ * returns the id of the next button that has been pressed or -1
+ * presses of several buttons at once are returned one per call
+ */
+int CheckButtons()
+{
+    BUTTON_EVENTS |= ButtonScannerTakePressed() & BUTTONS_MASK;
+    if ( BUTTON_EVENTS == 0 ) { return -1; }
 
-        if( CheckEndStopA() || CheckEndStopB() )
+    for (int i = 0; i < NUM_BUTTONS; i++)
+    {
+        // If button has been pressed
+        if ( BUTTON_EVENTS & (1U << i) )
         {
-            MotorChangeDirection();
+            BUTTON_EVENTS &= ~(1U << i);
+
+            LOG_DEBUG("Button pressed: %d", i);
+            BUTTON_PRESSED = i;
+            return i;
         }
-        
-        //Serial.print("stepsDone: ");
-        //Serial.println(stepsDone);
-        //Serial.print("MOTOR_PULSE_DELAY: ");
-        //Serial.println(MOTOR_PULSE_DELAY);
-        //Serial.print(CURRENT_STEP_POSITION);
-        //Serial.print("/");
-        //Serial.println(targetPosition);
     }
 
-    DisplayMessage(0,40, "Fertig!");
-    delay(1000);
-
-    PrepareForMainLoop();
+    return -1;
 }
 
+
 /*****************************************************
- * MotorMoveToEndStopA()
- * moves the motor until endstop A is triggered
+ *  CheckEndStopA()
+ *  returns true once after endstop A has stopped the StepEngine
  */
-void MotorMoveToEndStopA()
+bool CheckEndStopA()
 {
-    Serial.println("MotorMoveToEndStopA");
+    PROFILE(PROFILER_ENDSTOPS);
 
-    // endstop A should be in counter clock wise motor rotation
-    MOTOR_DIRECTION = HIGH;
-
-    // set motor speed
-    unsigned int maxMotorPulseDelay     = RPM2Delay( MOTOR_CALIBRATION_SPEED_RPM );
-    unsigned long startMotorPulseDelay   = 150000;
-    unsigned long stepsDone             = 0;
-
-    Serial.print("MOTOR_CALIBRATION_SPEED_RPM: ");
-    Serial.println(MOTOR_CALIBRATION_SPEED_RPM);
-    Serial.print("Converted to delay time with RPM2Delay -> ");
-    Serial.print("maxMotorPulseDelay: ");
-    Serial.println(maxMotorPulseDelay);
-    Serial.print("startMotorPulseDelay: ");
-    Serial.println(startMotorPulseDelay);
-    
-    while( CheckEndStopA() == false )
+    if ( StepEngineTakeEndStopEvent(STEP_ENGINE_ENDSTOP_A) )
     {
-        //MOTOR_PULSE_DELAY = LerpLinear(startMotorPulseDelay, maxMotorPulseDelay, stepsDone);
-        MOTOR_PULSE_DELAY = LinearMap(stepsDone, 0, ACCEL_STEPS, startMotorPulseDelay, maxMotorPulseDelay);
-
-        /*
-        if ( stepsDone <= ACCEL_STEPS )
-        {
-            Serial.print(stepsDone);
-            Serial.print("# MOTOR_PULSE_DELAY: ");
-            Serial.println(MOTOR_PULSE_DELAY);
-        }
-        */
-        
-        MotorStep();
-        stepsDone++;
+        LOG_INFO("endStopA betaetigt bei %lu", StepEngineGetEndStopPosition());
+        CheckEndStopDrift(DRIFT_MONITOR_ENDSTOP_A, 0);
+        return true;
     }
-    MotorChangeDirection();
+
+    return false;
 }
 
 
 /*****************************************************
- * MotorStep()
- * do a single motor step
+ *  CheckEndStopB()
+ *  returns true once after endstop B has stopped the StepEngine
  */
-void MotorStep()
+bool CheckEndStopB()
 {
-    digitalWrite(PIN_DRIVER_DIR, MOTOR_DIRECTION);
-    digitalWrite(PIN_DRIVER_PUL, HIGH);
-    delayMicroseconds(20);
-    digitalWrite(PIN_DRIVER_PUL, LOW);
-    delayMicroseconds(MOTOR_PULSE_DELAY - 20);
+    PROFILE(PROFILER_ENDSTOPS);
 
-    if (MOTOR_DIRECTION == HIGH)
+    if ( StepEngineTakeEndStopEvent(STEP_ENGINE_ENDSTOP_B) )
     {
-        CURRENT_STEP_POSITION--;
-    }
-    else
-    {
-        CURRENT_STEP_POSITION++;
+        LOG_INFO("endStopB betaetigt bei %lu", StepEngineGetEndStopPosition());
+        CheckEndStopDrift(DRIFT_MONITOR_ENDSTOP_B, CONFIG.trackSteps);
+        return true;
     }
 
-    //Serial.print("CURRENT_STEP_POSITION: ");
-    //Serial.println(CURRENT_STEP_POSITION);
+    return false;
 }
 
 
 /*****************************************************
- * PrepareForMainLoop()
- * Prepares the display and other stuff to go back from sub loops to the main loop
+ *  CheckEndStopDrift( byte endStop, unsigned long expected )
+ *  Records how far from the expected position an endstop has tripped,
+ *  as long as the counted position is valid. A move or drive mode that
+ *  runs into endstop A takes it as the new position 0 if the drift is
+ *  within POSITION_REZERO_MAX_PERCENT of the track. A larger drift is
+ *  no loss of a few steps but a wrong position or a glitch on the
+ *  switch line, the position is dropped and UiTask() homes instead.
+ *
+ *  endStop: DRIFT_MONITOR_ENDSTOP_A or DRIFT_MONITOR_ENDSTOP_B
+ *  expected: the position the endstop should trip at
  */
-void PrepareForMainLoop()
+void CheckEndStopDrift( byte endStop, unsigned long expected )
 {
-    DisplayClear();
-    DisplayMessage(0, 0, "Bahn frei!");
-    DisplayMessage(0, 20, "Position:");
-    DisplayMessage(0, 30, String(CURRENT_STEP_POSITION));
+    if ( !POSITION_REFERENCED ) { return; }
 
-    BUTTON_PRESSED = -1;
-    EncoderReset();
+    // the fast touches of the homing are followed by a slow one that is measured
+    if ( MOTION_STATE == MOTION_HOMING_FAST || MOTION_STATE == MOTION_HOMING ) { return; }
+
+    // endstop B is measured against a track length that the calibration is just measuring again
+    if ( endStop == DRIFT_MONITOR_ENDSTOP_B && (CONFIG.trackSteps == 0xFFFFFFFF || MOTION_STATE == MOTION_CALIBRATE_TO_B) ) { return; }
+
+    long drift = (long)(StepEngineGetEndStopPosition() - expected);
+    DriftMonitorRecord(endStop, drift);
+
+    bool normalOperation = MOTION_STATE == MOTION_IDLE || MOTION_STATE == MOTION_MOVING || MOTION_STATE == MOTION_REVERSING;
+    if ( !POSITION_REZERO_AT_A || endStop != DRIFT_MONITOR_ENDSTOP_A || !normalOperation || drift == 0 ) { return; }
+
+    // the bound is only known with a measured track
+    unsigned long maxDrift = CONFIG.trackSteps != 0xFFFFFFFF ? MotionMathPercent(CONFIG.trackSteps, POSITION_REZERO_MAX_PERCENT) : 0;
+    if ( (unsigned long)abs(drift) <= maxDrift )
+    {
+        LOG_INFO("Position set to 0 at endstop A");
+        StepEngineSetPosition(StepEngineGetPosition() - drift);
+        return;
+    }
+
+    LOG_WARN("Endstop A %ld steps from 0, homing", drift);
+    PositionJournalSetMoving( 0 );
+    POSITION_KNOWN = false;
+    POSITION_REFERENCED = false;
+    POSITION_HOMING_NEEDED = true;
 }
 
 
 /*****************************************************
- * UpdateDisplay()
+ * EncoderReset()
+ * Resets the encoder position to zero
  */
-void UpdateDisplay()
+void EncoderReset()
 {
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(BLACK);
-
-    display.setCursor(0, 0);
-    display.println("Position: ");
-    display.setCursor(0, 100);
-    display.println( String(CURRENT_STEP_POSITION ));
-
-    display.display();
+    LOG_DEBUG("EncoderReset()");
+    rotaryEncoder.reset();
+    ENCODER_CHANGE = 0;
+    ENCODER_VALUE = 0;
+    ENCODER_VALUE_OLD = 0;
 }
 
+
 /*****************************************************
- * LerpLinear(int from, int to, int deltaSteps)
- * interpolates a values with in a linear manner
- * 
- * from the starting value
- * to: the final value
- * deltaSteps: the number of steps when called in a loop = loop counter
- * 
- * Example: (in a loop)
- * MOTOR_PULSE_DELAY = LerpLinear(startMotorPulseDelay, maxMotorPulseDelay, loopCounter);
+ * LoadEEPROMData()
+ * Loads CONFIG from the EEPROM and replaces the values
+ * that have never been written by their defaults
  */
-unsigned int LerpLinear(unsigned int from, unsigned int to, unsigned int deltaSteps)
+void LoadEEPROMData()
 {
-    if (deltaSteps > ACCEL_STEPS )
+    LOG_DEBUG("LoadEEPROMData()");
+
+    // the only time the EEPROM is read, everything else reads CONFIG
+    ConfigStoreLoad();
+
+    LOG_DEBUG("    trackSteps: %lu", CONFIG.trackSteps);
+    for (byte i = 0; i < CONFIG_STORE_POSITIONS; i++)
     {
-        return to;
+        LOG_DEBUG("    positions[%u]: %lu", i, CONFIG.positions[i]);
     }
+    LOG_DEBUG("    minSpeedRpm: %u", CONFIG.minSpeedRpm);
+    LOG_DEBUG("    maxSpeedRpm: %u", CONFIG.maxSpeedRpm);
+    LOG_DEBUG("    calibrationSpeedRpm: %u", CONFIG.calibrationSpeedRpm);
+    LOG_DEBUG("    accelSteps: %u", CONFIG.accelSteps);
+    LOG_DEBUG("    motorPpr: %u", CONFIG.motorPpr);
+
+    // the values behind motorPpr have been added later, an unwritten
+    // EEPROM cell reads 255 and falls back to the default
+    if ( CONFIG.motorProfile >= RAMP_PROFILE_COUNT ) { CONFIG.motorProfile = RAMP_PROFILE_LINEAR; }
+    LOG_DEBUG("    motorProfile: %u", CONFIG.motorProfile);
 
-    int diffValue = to - from;
-    float valuePerStep = (float)diffValue / (float)(ACCEL_STEPS);
+    if ( CONFIG.softLimitSteps == 0xFFFF ) { CONFIG.softLimitSteps = 200; }
+    LOG_DEBUG("    softLimitSteps: %u", CONFIG.softLimitSteps);
 
-    return from + ceil((float)deltaSteps * valuePerStep);
+    if ( CONFIG.uiLanguage >= UI_TEXT_LANGUAGE_COUNT ) { CONFIG.uiLanguage = UI_TEXT_GERMAN; }
+    UiTextSetLanguage(CONFIG.uiLanguage);
+    LOG_DEBUG("    uiLanguage: %u", CONFIG.uiLanguage);
+
+    UpdateRampTable();
 }
 
 
 /*****************************************************
- * LinearMap(long ax, long aMin, long aMax, long bMin, long bMax)
- * Maps value ax from range aMin/aMax into range bMin/bMax
+ * MotorChangeDirection()
+ * Changes the direction of the motor
  */
-long LinearMap(long ax, long aMin, long aMax, long bMin, long bMax)
+void MotorChangeDirection()
 {
-    if (ax >= aMax) return bMax; 
-    double slope = 1.0 * (bMax-bMin) / (aMax-aMin);
-    return bMin + round(slope * (ax + aMin));
+    StepEngineSetDirection( !StepEngineGetDirection() );
 }
 
 
 /*****************************************************
- *  DisplayClear()
+ *  MotorCalibrateEndStops()
+ *  Starts to measure the track length, MotionTask() moves to endstop B
+ *  and counts the steps back to endstop A, CALIBRATION_RUNS times
  */
-void DisplayClear()
+void MotorCalibrateEndStops()
 {
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(BLACK);
+    LOG_DEBUG("MotorCalibrateEndStops()");
+
+    // with the stored track length most of the way is done at full speed
+    CALIBRATION_ESTIMATE = 0;
+    CALIBRATION_MARGIN = 0;
+    if ( CONFIG.trackSteps > 0 && CONFIG.trackSteps != 0xFFFFFFFF )
+    {
+        CALIBRATION_ESTIMATE = CONFIG.trackSteps;
+        CALIBRATION_MARGIN = MotionMathPercent(CONFIG.trackSteps, CALIBRATION_STORED_MARGIN_PERCENT);
+    }
+
+    // the way to endstop B is only known if the position is known
+    unsigned long distance = 0;
+    if ( POSITION_KNOWN && StepEngineGetPosition() < CALIBRATION_ESTIMATE ) { distance = CALIBRATION_ESTIMATE - StepEngineGetPosition(); }
+
+    // the stored position is worthless until endstop A has been found again
+    PositionJournalSetMoving( 0 );
+    POSITION_KNOWN = false;
+
+    CALIBRATION_RUN = 0;
+    CALIBRATION_SUM = 0;
+
+    DisplayClear();
+    DisplayMessage(0, 0, UI_TEXT(UI_TEXT_MEASURE_TRACK));
+
+    // Goto first End Stop B
+    MotorCalibrateRun(LOW, distance);
+    MOTION_STATE = MOTION_CALIBRATE_TO_B;
+    MOTION_STATE_SHOWN = MOTION_CALIBRATE_TO_B;
 }
 
 
 /*****************************************************
- *  DisplayMessage(int x, int y, String message)
+ * MotorCalibrateRun( bool direction, unsigned long distance )
+ * Starts a part of the measurement. With a known distance to the
+ * endstop the motor runs at full speed and decelerates to a stop
+ * CALIBRATION_MARGIN steps in front of it, otherwise it moves at
+ * calibration speed until the StepEngine stops at the endstop.
+ *
+ * direction: LOW moves to endstop B, HIGH to endstop A
+ * distance: the expected steps to the endstop, 0 = unknown
  */
-void DisplayMessage(int x, int y, String message, bool inverted)
+void MotorCalibrateRun( bool direction, unsigned long distance )
 {
-    if (inverted )
+    StepEngineSetDirection(direction);
+
+    if ( distance > CALIBRATION_MARGIN && CALIBRATION_MARGIN > 0 )
     {
-        display.setTextColor(WHITE, BLACK);
-    }else{
-        display.setTextColor(BLACK, WHITE);
+        StepEngineStartProfile(distance - CALIBRATION_MARGIN, RPM2Delay( CONFIG.maxSpeedRpm ));
+        return;
     }
 
-    display.setCursor(x, y);
-    display.println(message);
-    //Serial.println(message);
-    display.display();
+    // the StepEngine accelerates along the ramp table up to the calibration speed
+    StepEngineStartProfile(STEP_ENGINE_CONTINUOUS, RPM2Delay( CONFIG.calibrationSpeedRpm ));
 }
 
 
 /*****************************************************
- * SavePosition
- * Asks the user to save the current position to EEPROM
+ * MotorCalibrateFinish()
+ * Takes the measurement that has just ended at endstop A and
+ * starts the next one, after the last one the mean is stored
+ * as the track length
  */
-void SavePosition()
+void MotorCalibrateFinish()
 {
-    // reset the encoder to position zero and 
-    // resetthe last button press
-    EncoderReset();
-    BUTTON_PRESSED = -1;
+    unsigned long steps = CALIBRATION_STEPS;
 
-    // display a message
+    CALIBRATION_RUN++;
+    CALIBRATION_SUM += steps;
+    if ( CALIBRATION_RUN == 1 || steps < CALIBRATION_MIN ) { CALIBRATION_MIN = steps; }
+    if ( CALIBRATION_RUN == 1 || steps > CALIBRATION_MAX ) { CALIBRATION_MAX = steps; }
+
+    LOG_INFO("Calibration run %d: %lu steps", CALIBRATION_RUN, steps);
+
+    // the next run knows the track from this one
+    if ( CALIBRATION_RUN < CALIBRATION_RUNS )
+    {
+        CALIBRATION_ESTIMATE = steps;
+        CALIBRATION_MARGIN = MotionMathPercent(steps, CALIBRATION_MARGIN_PERCENT);
+        MotorCalibrateRun(LOW, steps);
+        MOTION_STATE = MOTION_CALIBRATE_TO_B;
+        return;
+    }
+
+    CONFIG.trackSteps = (CALIBRATION_SUM + CALIBRATION_RUN / 2) / CALIBRATION_RUN;
+
+    LOG_INFO("Track steps: mean %lu, min %lu, max %lu, spread %lu", CONFIG.trackSteps, CALIBRATION_MIN, CALIBRATION_MAX, CALIBRATION_MAX - CALIBRATION_MIN);
+
+    StepEngineSetDirection(LOW);
+    MotorBackOffEndStopA();
+    MOTION_STATE = MOTION_CALIBRATE_BACK_OFF;
+}
+
+
+/*****************************************************
+ * MotorBackOffEndStopA()
+ * Sets the position at endstop A to 0 and starts to move back 10% of
+ * the CONFIG.trackSteps to not permanent press endstop A
+ */
+void MotorBackOffEndStopA()
+{
+    // Now motor is at position 0
+    // from now on the StepEngine tracks every step movement
+    StepEngineSetPosition(0);
+
+    unsigned long tenPercentSteps = MotionMathPercent(CONFIG.trackSteps, 10);
+
+    LOG_DEBUG("tenPercentSteps: %lu of %lu", tenPercentSteps, CONFIG.trackSteps);
+
+    StepEngineStartProfile(tenPercentSteps, RPM2Delay( CONFIG.calibrationSpeedRpm ));
+}
+
+
+/*****************************************************
+ * MotorModeSwitch()
+ * switches through the different motor modes,
+ * MainScreenUpdate() calls it at standstill only
+ */
+void MotorModeSwitch()
+{
+    MOTOR_MODE++;
+    if (MOTOR_MODE >= 2)
+    {
+        MOTOR_MODE = 0;
+    }
+
+    DisplayClear();
+
+    if ( MOTOR_MODE == 0 )
+    {
+        DisplayMessage( 0,0, UI_TEXT(UI_TEXT_DRIVE_MODE));
+        StepEngineSetDirection(HIGH);
+    }
+    else if ( MOTOR_MODE == 1 )
+    {
+        DisplayMessage( 0,0, UI_TEXT(UI_TEXT_STEP_MODE));
+    }
+
+    LOG_INFO("MOTOR_MODE: %u", MOTOR_MODE);
+
+    // back to main loop
+    UiShowMessage(1500, UI_MAIN);
+}
+
+/*****************************************************
+ * DrawMotorSettings( byte selectedCol, byte selectedRow )
+ * 
+ * Draw the motor settings menu
+ * selectedCol is the currently selected column of the menu
+ * selectedRow is the currently selected row of the menu
+ * With these two values we can select a cell in the menu
+ * that can be drawn inverted
+ */
+void DrawMotorSettings( byte selectedCol, byte selectedRow )
+{
     DisplayClear();
-    DisplayMessage(0, 0, "Position");
-    DisplayMessage(0, 10, "Speichern?");
-    DisplayMessage(0, 20, String(CURRENT_STEP_POSITION));
-    
-    // loop until a button is pressed to store the current positon to
-    // or to cancel storing the position
-    while (BUTTON_PRESSED == -1)
+
+    display.drawChar(78, 40, 0x1A, BLACK, WHITE, 1);
+
+    // scroll the menu as soon as the selected row is below the display
+    byte firstRow = 0;
+    if ( selectedRow >= MOTOR_SETTINGS_VISIBLE_ROWS ) { firstRow = selectedRow - MOTOR_SETTINGS_VISIBLE_ROWS + 1; }
+
+    for (byte i = 0; i < MOTOR_SETTINGS_VISIBLE_ROWS; i++)
     {
-        // check for button press
-        CheckButtons();
-        if ( BUTTON_PRESSED >= 0 && BUTTON_PRESSED <= 11 )
+        byte row = firstRow + i;
+
+        bool valueSelected = selectedCol == 1 && selectedRow == row;
+
+        // the labels have the same order as the rows
+        DisplayMessage(0, i * 10, UI_TEXT((UiTextId)(UI_TEXT_SETTING_MAX_RPM + row)), selectedCol == 0 && selectedRow == row);
+
+        if ( row == 5 ) { DisplayMessage(45, i * 10, UI_TEXT(CONFIG.motorProfile == RAMP_PROFILE_SCURVE ? UI_TEXT_PROFILE_SCURVE : UI_TEXT_PROFILE_LINEAR), valueSelected); }
+        else if ( row == 7 ) { DisplayMessage(45, i * 10, UI_TEXT(UI_TEXT_LANGUAGE_NAME), valueSelected); }
+        else { DisplayNumber(45, i * 10, MotorSettingGet( row ), valueSelected); }
+    }
+}
+
+/*****************************************************
+ * MotorSettings()
+ * Opens the menu to setup some values for the motor
+ * controlled with the rotary encoder, the boot screen and
+ * MainScreenUpdate() open it at standstill only
+ */
+void MotorSettings()
+{
+    SETTINGS_SELECTED_COL = 0;
+    SETTINGS_SELECTED_ROW = 0;
+    EncoderReset();
+    rotaryEncoder.setAccelerationEnabled(false);
+
+    // remember if any value has been changed to check
+    // if writing to EEPROM is neccessery at all
+    SETTINGS_CHANGED = false;
+
+    // Draw the menu
+    DrawMotorSettings( SETTINGS_SELECTED_COL, SETTINGS_SELECTED_ROW );
+}
+
+
+/*****************************************************
+ * MotorSettingsUpdate()
+ * Handles the encoder and the buttons in the motor settings menu
+ */
+void MotorSettingsUpdate()
+{
+    // First column is selected
+    // here we can select the row with the encoder
+    if ( SETTINGS_SELECTED_COL == 0 )
+    {
+        ENCODER_VALUE = rotaryEncoder.getAccumulate();
+
+        if ( ENCODER_CHANGE != 0 )
         {
-            // store position
-            EEPROM.put( CalculateEEPROMAddressForButton(BUTTON_PRESSED), CURRENT_STEP_POSITION );
-
-            // display message
-            DisplayMessage(0, 30, "Gespeichert");
-            DisplayMessage(0, 40, "Schalter: ");
-            DisplayMessage(60, 40, String(BUTTON_PRESSED+1));
-            delay(2000);
+            if (SETTINGS_SELECTED_ROW == 0 && ENCODER_CHANGE < 0){ SETTINGS_SELECTED_ROW = MOTOR_SETTINGS_ROWS;}
+            SETTINGS_SELECTED_ROW = SETTINGS_SELECTED_ROW + ENCODER_CHANGE;
+            if (SETTINGS_SELECTED_ROW > MOTOR_SETTINGS_ROWS - 1){ SETTINGS_SELECTED_ROW = 0;}
+
+            LOG_DEBUG("selectedRow: %u", SETTINGS_SELECTED_ROW);
+
+            DrawMotorSettings( SETTINGS_SELECTED_COL, SETTINGS_SELECTED_ROW );
         }
+    }
 
-        // if button 12 or 13 is pressed: cancel
-        else if (BUTTON_PRESSED >= 12)
+    // Second column is selected
+    // here we can adjust the selected value
+    else if ( SETTINGS_SELECTED_COL == 1 )
+    {
+        if ( ENCODER_CHANGE != 0 )
         {
-            // cancel save
-            DisplayMessage(0, 30, "Abbruch");
-            delay(2000);
+            // calculate a value based on acceleration (= ENCODER_CHANGE)
+            // the higher ENCODER_CHANGE is, ther more gets added to the value
+            int16_t calcValueChange = ENCODER_CHANGE * ENCODER_CHANGE;
+            if (ENCODER_CHANGE < 0){ calcValueChange = -calcValueChange; }
+
+            if ( SETTINGS_SELECTED_ROW == 0 ){ 
+                CONFIG.maxSpeedRpm = CONFIG.maxSpeedRpm + calcValueChange;
+                CONFIG.maxSpeedRpm = constrain(CONFIG.maxSpeedRpm, 5, 1000);
+
+            }
+            else if ( SETTINGS_SELECTED_ROW == 1 ){ 
+                CONFIG.minSpeedRpm = CONFIG.minSpeedRpm + calcValueChange;
+                CONFIG.minSpeedRpm = constrain(CONFIG.minSpeedRpm, 5, 1000);
+            }
+            else if ( SETTINGS_SELECTED_ROW == 2 ){ 
+                CONFIG.calibrationSpeedRpm = CONFIG.calibrationSpeedRpm + calcValueChange;
+                //CONFIG.calibrationSpeedRpm = constrain(CONFIG.calibrationSpeedRpm, 5, 1000);
+                if ( CONFIG.calibrationSpeedRpm < 5 ){ CONFIG.calibrationSpeedRpm = 1000; }
+                else if ( CONFIG.calibrationSpeedRpm > 1000 ){ CONFIG.calibrationSpeedRpm = 5; }
+            }
+            else if ( SETTINGS_SELECTED_ROW == 3 ){ 
+                CONFIG.accelSteps = CONFIG.accelSteps + calcValueChange;
+                CONFIG.accelSteps = constrain(CONFIG.accelSteps, 0, 2000);
+            }
+            else if ( SETTINGS_SELECTED_ROW == 4 ){ 
+                CONFIG.motorPpr = CONFIG.motorPpr + calcValueChange;
+                CONFIG.motorPpr = constrain(CONFIG.motorPpr, 100, 2000);
+            }
+            else if ( SETTINGS_SELECTED_ROW == 5 ){ 
+                // any turn toggles between the linear and the S-curve profile
+                CONFIG.motorProfile = CONFIG.motorProfile == RAMP_PROFILE_LINEAR ? RAMP_PROFILE_SCURVE : RAMP_PROFILE_LINEAR;
+            }
+            else if ( SETTINGS_SELECTED_ROW == 6 ){ 
+                CONFIG.softLimitSteps = CONFIG.softLimitSteps + calcValueChange;
+                CONFIG.softLimitSteps = constrain(CONFIG.softLimitSteps, 0, 5000);
+            }
+            else if ( SETTINGS_SELECTED_ROW == 7 ){ 
+                // any turn switches to the next language, the menu is redrawn in it right away
+                CONFIG.uiLanguage = (CONFIG.uiLanguage + 1) % UI_TEXT_LANGUAGE_COUNT;
+                UiTextSetLanguage( CONFIG.uiLanguage );
+            }
+
+            SETTINGS_CHANGED = true;
+            DrawMotorSettings( SETTINGS_SELECTED_COL, SETTINGS_SELECTED_ROW );
         }
     }
 
-    // initialise displayreset last BUTTON_PRESSED 
-    // and back to main loop
-    PrepareForMainLoop();
+    // check for rotay encoder knob switch press
+    if (BUTTON_PRESSED == 13)
+    {
+        SETTINGS_SELECTED_COL++;
+        if ( SETTINGS_SELECTED_COL > 1 ){ SETTINGS_SELECTED_COL = 0; }
 
-    // Dump EEPROM to console 
-    LoadEEPROMData();
+        if (SETTINGS_SELECTED_COL == 0) { rotaryEncoder.setAccelerationEnabled(false); }
+        else if (SETTINGS_SELECTED_COL == 1) { rotaryEncoder.setAccelerationEnabled(true); }
+
+        LOG_DEBUG("selectedCol: %u", SETTINGS_SELECTED_COL);
+
+        EncoderReset();
+        DrawMotorSettings( SETTINGS_SELECTED_COL, SETTINGS_SELECTED_ROW );
+    }
+
+    // check for button 12 (red button) to initiate saving end exit motor settings
+    else if (BUTTON_PRESSED == 12)
+    {
+        // only if any of the values have changed write to EEPROM
+        if ( SETTINGS_CHANGED )
+        {
+            SaveMotorSettings();
+        }
+
+        EncoderReset();
+        rotaryEncoder.setAccelerationEnabled(true);
+        UiEnterState(SETTINGS_RETURN_STATE);
+    }
 }
 
 
+/*****************************************************
+ * MotorSettingGet( byte row )
+ * returns the value of a motor setting, row is the row in the settings menu
+ * the profile is RAMP_PROFILE_LINEAR or RAMP_PROFILE_SCURVE,
+ * the language UI_TEXT_GERMAN or UI_TEXT_ENGLISH
+ */
+unsigned int MotorSettingGet( byte row )
+{
+    if ( row == 0 ) { return CONFIG.maxSpeedRpm; }
+    else if ( row == 1 ) { return CONFIG.minSpeedRpm; }
+    else if ( row == 2 ) { return CONFIG.calibrationSpeedRpm; }
+    else if ( row == 3 ) { return CONFIG.accelSteps; }
+    else if ( row == 4 ) { return CONFIG.motorPpr; }
+    else if ( row == 5 ) { return CONFIG.motorProfile; }
+    else if ( row == 6 ) { return CONFIG.softLimitSteps; }
+    else if ( row == 7 ) { return CONFIG.uiLanguage; }
+
+    return 0;
+}
+
+
+/*****************************************************
+ * MotorSettingSet( byte row, unsigned int value )
+ * Changes a motor setting, row is the row in the settings menu
+ * returns false if the value is outside of the range the menu allows
+ */
+bool MotorSettingSet( byte row, unsigned int value )
+{
+    if ( row == 0 && value >= 5 && value <= 1000 ) { CONFIG.maxSpeedRpm = value; }
+    else if ( row == 1 && value >= 5 && value <= 1000 ) { CONFIG.minSpeedRpm = value; }
+    else if ( row == 2 && value >= 5 && value <= 1000 ) { CONFIG.calibrationSpeedRpm = value; }
+    else if ( row == 3 && value <= 2000 ) { CONFIG.accelSteps = value; }
+    else if ( row == 4 && value >= 100 && value <= 2000 ) { CONFIG.motorPpr = value; }
+    else if ( row == 5 && value < RAMP_PROFILE_COUNT ) { CONFIG.motorProfile = value; }
+    else if ( row == 6 && value <= 5000 ) { CONFIG.softLimitSteps = value; }
+    else if ( row == 7 && value < UI_TEXT_LANGUAGE_COUNT ) { CONFIG.uiLanguage = value; UiTextSetLanguage( CONFIG.uiLanguage ); }
+    else { return false; }
+
+    return true;
+}
+
+
+/*****************************************************
+ * MotorMoveTo( unsigned long targetPosition )
+ * starts to move the motor to the target position,
+ * MotionTask() ends the move as soon as the target position is met
+ * returns false if no position has been saved for the target
+ *
+ * A move that is already running is re-planned from its current position
+ * and speed: a target further ahead extends the move, a target behind the
+ * motor or too close to brake for lets it decelerate and turn around.
+ */
+bool MotorMoveTo( unsigned long targetPosition )
+{
+    LOG_DEBUG("MotorMoveTo() targetPosition: %lu", targetPosition);
+
+    // cancel if target position is 0 or 4294967295 which is
+    // the max value for unsigned long
+    if ( targetPosition == 0 || targetPosition == 4294967295 )
+    {
+        LOG_WARN("MotorMoveTo() cancelled, no position saved");
+        return false;
+    } 
+
+    MOVE_TARGET_POSITION = targetPosition;
+    MOVE_START_POSITION = StepEngineGetPosition();
+    MOVE_END_REASON = SERIAL_PROTOCOL_MOVE_REACHED;
+
+    if ( MOTION_STATE == MOTION_MOVING || MOTION_STATE == MOTION_REVERSING )
+    {
+        PositionJournalSetMoving( targetPosition );
+        MOTION_STATE = StepEngineSetTarget( targetPosition ) ? MOTION_MOVING : MOTION_REVERSING;
+
+        // braking towards endstop A ends somewhere behind the target
+        if ( MOTION_STATE == MOTION_REVERSING && StepEngineGetDirection() == HIGH ) { PositionJournalSetMoving( 0 ); }
+        return true;
+    }
+
+    MotorStartMove();
+    return true;
+}
+
+
+/*****************************************************
+ * MotorMoveToButton( byte buttonID )
+ * moves the motor to the position stored for the button,
+ * while the motor is moving the position is queued behind the current move
+ * returns false if no valid position is stored or the queue is full
+ */
+bool MotorMoveToButton( byte buttonID )
+{
+    unsigned long targetPosition = CONFIG.positions[buttonID];
+
+    // the target position has to be in the total track steps range
+    if ( targetPosition > CONFIG.trackSteps ) { return false; }
+
+    if ( MotorIsMoving() )
+    {
+        // 0 means that no position has been saved to the button
+        if ( targetPosition == 0 ) { return false; }
+        return MoveQueuePush( targetPosition );
+    }
+
+    return MotorMoveTo( targetPosition );
+}
+
+
+/*****************************************************
+ * MotorTargetSlot( unsigned long targetPosition )
+ * returns the index of the first button the position is stored on or -1
+ */
+int MotorTargetSlot( unsigned long targetPosition )
+{
+    for (int i = 0; i < 12; i++)
+    {
+        if ( CONFIG.positions[i] == targetPosition ) { return i; }
+    }
+
+    return -1;
+}
+
+
+/*****************************************************
+ * MotorIsMoving()
+ * returns true while a move to a target is running
+ */
+bool MotorIsMoving()
+{
+    return MOTION_STATE == MOTION_MOVING || MOTION_STATE == MOTION_REVERSING;
+}
+
+
+/*****************************************************
+ * MotorBlendNextMove()
+ * If the next queued target lies further on in the direction of the
+ * current move, the move continues to it without stopping in between.
+ * A target in the other direction waits until the current move has
+ * braked to standstill at its target.
+ */
+void MotorBlendNextMove()
+{
+    if ( MOVE_QUEUE_COUNT == 0 || MOTION_STATE != MOTION_MOVING ) { return; }
+
+    unsigned long nextPosition = MOVE_QUEUE[MOVE_QUEUE_HEAD];
+    bool increasing = StepEngineGetDirection() == LOW;
+
+    if ( ( increasing && nextPosition > MOVE_TARGET_POSITION ) || ( !increasing && nextPosition < MOVE_TARGET_POSITION ) )
+    {
+        MotorMoveTo( MoveQueuePop() );
+    }
+}
+
+
+/*****************************************************
+ * MotorSkipMove()
+ * Drops the current target, the move is re-planned to the next queued target
+ */
+void MotorSkipMove()
+{
+    if ( MOVE_QUEUE_COUNT == 0 || !MotorIsMoving() ) { return; }
+
+    MotorMoveTo( MoveQueuePop() );
+}
+
+
+/*****************************************************
+ * MotorStopMove()
+ * Drops all queued targets and brakes the current move along the ramp
+ */
+void MotorStopMove()
+{
+    MoveQueueClear();
+
+    if ( !MotorIsMoving() ) { return; }
+
+    // the current position is always too close to reach, so the engine brakes as fast as the ramp allows
+    StepEngineSetTarget( StepEngineGetPosition() );
+    MOTION_STATE = MOTION_MOVING;
+    MOVE_END_REASON = SERIAL_PROTOCOL_MOVE_STOPPED;
+}
+
+
+/*****************************************************
+ * MotorMoveDone()
+ * Ends the move and tells the host where and why it has ended
+ */
+void MotorMoveDone()
+{
+    MOTION_STATE = MOTION_IDLE;
+
+    StepEngineJitter jitter;
+    StepEngineGetJitter( &jitter );
+    if ( jitter.enabled && jitter.moveSteps > 0 )
+    {
+        LOG_INFO("Step jitter of %u steps: min %d, max %d, mean %ld (0.5 us)", jitter.moveSteps, jitter.moveMin, jitter.moveMax, jitter.moveSum / jitter.moveSteps);
+    }
+
+    byte notification[5];
+    unsigned long position = StepEngineGetPosition();
+    notification[0] = MOVE_END_REASON;
+    memcpy( notification + 1, &position, sizeof(position) );
+    SerialProtocolSend( SERIAL_PROTOCOL_NOTIFY_MOVE_DONE, 0, notification, sizeof(notification) );
+}
+
+
+/*****************************************************
+ * MoveQueuePush( unsigned long targetPosition )
+ * Adds a target behind the last queued target
+ * returns false if the queue is full
+ */
+bool MoveQueuePush( unsigned long targetPosition )
+{
+    if ( MOVE_QUEUE_COUNT >= MOVE_QUEUE_SIZE ) { return false; }
+
+    MOVE_QUEUE[(MOVE_QUEUE_HEAD + MOVE_QUEUE_COUNT) % MOVE_QUEUE_SIZE] = targetPosition;
+    MOVE_QUEUE_COUNT++;
+    return true;
+}
+
+
+/*****************************************************
+ * MoveQueuePop()
+ * Removes and returns the next target, the queue must not be empty
+ */
+unsigned long MoveQueuePop()
+{
+    unsigned long targetPosition = MOVE_QUEUE[MOVE_QUEUE_HEAD];
+    MOVE_QUEUE_HEAD = (MOVE_QUEUE_HEAD + 1) % MOVE_QUEUE_SIZE;
+    MOVE_QUEUE_COUNT--;
+    return targetPosition;
+}
+
+
+/*****************************************************
+ * MoveQueueClear()
+ * Drops all queued targets
+ */
+void MoveQueueClear()
+{
+    MOVE_QUEUE_HEAD = 0;
+    MOVE_QUEUE_COUNT = 0;
+}
+
+
+/*****************************************************
+ * MotorStartMove()
+ * starts a new move from standstill to MOVE_TARGET_POSITION
+ */
+void MotorStartMove()
+{
+    MOTION_STATE = MOTION_MOVING;
+
+    unsigned long currentPosition = StepEngineGetPosition();
+    if ( currentPosition == MOVE_TARGET_POSITION ) { return; }
+
+    unsigned long stepsNeeded = abs( (long)currentPosition - (long)MOVE_TARGET_POSITION );
+
+    // set the correct direction to reach the target position
+    StepEngineSetDirection( currentPosition < MOVE_TARGET_POSITION ? LOW : HIGH );
+    PositionJournalSetMoving( MOVE_TARGET_POSITION );
+
+    // the StepEngine accelerates and decelerates along the ramp table on its own,
+    // for moves shorter than two ramps it turns around at the speed it has reached
+    StepEngineStartProfile(stepsNeeded, RPM2Delay( CONFIG.maxSpeedRpm ));
+}
+
+/*****************************************************
+ * MotorMoveToEndStopA()
+ * starts to move the motor to endstop A. If the position is roughly
+ * known the motor runs at full speed to just before endstop A first,
+ * MotionTask() then approaches endstop A at calibration speed, backs
+ * off a little and sets position 0 on a slow second approach
+ */
+void MotorMoveToEndStopA()
+{
+    LOG_DEBUG("MotorMoveToEndStopA");
+
+    // the position known so far, or from the journal the lower one of the
+    // last rest position and the target of the move after it, without both
+    // the motor approaches endstop A at calibration speed all the way
+    unsigned long estimate = 0;
+    bool estimated = POSITION_KNOWN;
+    if ( estimated ) { estimate = StepEngineGetPosition(); }
+    else { estimated = PositionJournalGetLowestPosition(&estimate); }
+
+    // the stored position is worthless until endstop A has been found again
+    PositionJournalSetMoving( 0 );
+    POSITION_KNOWN = false;
+    HOMING_START_TIME = millis();
+
+    // endstop A should be in counter clock wise motor rotation
+    StepEngineSetDirection(HIGH);
+
+    unsigned long margin = MotionMathPercent(CONFIG.trackSteps, MOTOR_HOMING_MARGIN_PERCENT);
+    if ( estimated && CONFIG.trackSteps != 0xFFFFFFFF && estimate <= CONFIG.trackSteps && estimate > margin )
+    {
+        LOG_INFO("Homing from about %lu", estimate);
+
+        // the profile decelerates to standstill in front of endstop A
+        StepEngineStartProfile(estimate - margin, RPM2Delay( CONFIG.maxSpeedRpm ));
+        MOTION_STATE = MOTION_HOMING_FAST;
+        return;
+    }
+
+    MotorHomingApproach();
+}
+
+
+/*****************************************************
+ * MotorHomingApproach()
+ * Accelerates towards endstop A up to the calibration speed,
+ * the StepEngine stops at the switch
+ */
+void MotorHomingApproach()
+{
+    StepEngineSetDirection(HIGH);
+    StepEngineStartProfile(STEP_ENGINE_CONTINUOUS, RPM2Delay( CONFIG.calibrationSpeedRpm ));
+    MOTION_STATE = MOTION_HOMING;
+}
+
+
+/*****************************************************
+ * MotorHomingRelease()
+ * Moves MOTOR_HOMING_RELEASE_STEPS away from endstop A,
+ * so the slow approach closes the switch once more
+ */
+void MotorHomingRelease()
+{
+    StepEngineSetDirection(LOW);
+    StepEngineStart(MOTOR_HOMING_RELEASE_STEPS, MOTOR_HOMING_CREEP_PULSE_DELAY);
+    MOTION_STATE = MOTION_HOMING_RELEASE;
+}
+
+
+/*****************************************************
+ * PrepareForMainLoop()
+ * Prepares the display and other stuff to go back from sub loops to the main loop
+ */
+void PrepareForMainLoop()
+{
+    DisplayClear();
+    DisplayMessage(0, 0, UI_TEXT(UI_TEXT_TRACK_CLEAR));
+    DisplayMessage(0, 20, UI_TEXT(UI_TEXT_POSITION));
+    DrawMainScreenValues();
+
+    BUTTON_PRESSED = -1;
+    EncoderReset();
+}
+
+
+/*****************************************************
+ *  DisplayClear()
+ */
+void DisplayClear()
+{
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setTextColor(BLACK);
+}
+
+
+/*****************************************************
+ * DisplaySetPosition(int x, int y, bool inverted)
+ * Moves the text cursor and sets the colors for the next text
+ */
+void DisplaySetPosition(int x, int y, bool inverted)
+{
+    if (inverted )
+    {
+        display.setTextColor(WHITE, BLACK);
+    }else{
+        display.setTextColor(BLACK, WHITE);
+    }
+
+    display.setCursor(x, y);
+}
+
+
+/*****************************************************
+ *  DisplayMessage(int x, int y, const char *message, bool inverted)
+ *  Draws a text from RAM, e.g. a buffer formatted on the stack
+ */
+void DisplayMessage(int x, int y, const char *message, bool inverted)
+{
+    PROFILE(PROFILER_DRAW_TEXT);
+
+    DisplaySetPosition(x, y, inverted);
+    display.println(message);
+}
+
+
+/*****************************************************
+ *  DisplayMessage(int x, int y, const __FlashStringHelper *message, bool inverted)
+ *  Draws a text right from flash, pass literals as F("text")
+ */
+void DisplayMessage(int x, int y, const __FlashStringHelper *message, bool inverted)
+{
+    PROFILE(PROFILER_DRAW_TEXT);
+
+    DisplaySetPosition(x, y, inverted);
+    display.println(message);
+}
+
+
+/*****************************************************
+ *  DisplayNumber(int x, int y, unsigned long value, bool inverted)
+ *  Draws a number, Print formats it in a buffer on the stack
+ */
+void DisplayNumber(int x, int y, unsigned long value, bool inverted)
+{
+    PROFILE(PROFILER_DRAW_TEXT);
+
+    DisplaySetPosition(x, y, inverted);
+    display.println(value);
+}
+
+
+/*****************************************************
+ * DisplayTask()
+ * Sends the next slice of the changes the screens have drawn to the
+ * LCD, a full screen takes several loops but never blocks the loop
+ * for more than DISPLAY_SLICE_BUDGET
+ */
+void DisplayTask()
+{
+    PROFILE(PROFILER_DISPLAY);
+
+    if ( display.flush( DISPLAY_SLICE_BUDGET ) == 0 ) { return; }
+
+    // report every new worst case, it settles after the first screens
+    if ( display.getWorstSlice() > DISPLAY_WORST_SLICE )
+    {
+        DISPLAY_WORST_SLICE = display.getWorstSlice();
+        LOG_INFO("LCD slice max %lu us", DISPLAY_WORST_SLICE);
+    }
+}
+
+
+/*****************************************************
+ * SavePosition
+ * Asks the user to save the current position to EEPROM,
+ * MainScreenUpdate() calls it at standstill only
+ */
+void SavePosition()
+{
+    // reset the encoder to position zero
+    EncoderReset();
+
+    // display a message
+    DisplayClear();
+    DisplayMessage(0, 0, UI_TEXT(UI_TEXT_SAVE_POSITION));
+    DisplayMessage(0, 10, UI_TEXT(UI_TEXT_SAVE_QUESTION));
+    DisplayNumber(0, 20, StepEngineGetPosition());
+}
+
+
+/*****************************************************
+ * SavePositionUpdate
+ * Waits for a button press to store the current positon to
+ * or to cancel storing the position
+ */
+void SavePositionUpdate()
+{
+    if ( BUTTON_PRESSED >= 0 && BUTTON_PRESSED <= 11 )
+    {
+        // store position, EepromWriterTask() writes it in the background
+        CONFIG.positions[BUTTON_PRESSED] = StepEngineGetPosition();
+        CONFIG_STORE_SAVE(positions[BUTTON_PRESSED]);
+
+        // display message
+        DisplayMessage(0, 30, UI_TEXT(UI_TEXT_SAVED));
+        DisplayMessage(0, 40, UI_TEXT(UI_TEXT_BUTTON));
+        DisplayNumber(60, 40, BUTTON_PRESSED+1);
+        UiShowMessage(2000, UI_MAIN);
+    }
+
+    // if button 12 or 13 is pressed: cancel
+    else if (BUTTON_PRESSED >= 12)
+    {
+        // cancel save
+        DisplayMessage(0, 30, UI_TEXT(UI_TEXT_CANCELLED));
+        UiShowMessage(2000, UI_MAIN);
+    }
+}
+
 
 void SaveMotorSettings()
 {
-    Serial.println("SaveMotorSettings");
-
-    // calculate adress of MOTOR_MIN_SPEED_RPM
-    // the first 13 values are unsigned longs
-    int address = sizeof(unsigned long) * 13;
-
-    // MOTOR_MIN_SPEED_RPM
-    EEPROM.put( address, MOTOR_MIN_SPEED_RPM );
-    Serial.print("    Saved MOTOR_MIN_SPEED_RPM: ");
-    Serial.print(MOTOR_MIN_SPEED_RPM);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_MIN_SPEED_RPM);
-
-    // MOTOR_MAX_SPEED_RPM
-    EEPROM.put( address, MOTOR_MAX_SPEED_RPM );
-    Serial.print("    Saved MOTOR_MAX_SPEED_RPM: ");
-    Serial.print(MOTOR_MAX_SPEED_RPM);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_MAX_SPEED_RPM);
-
-    // MOTOR_CALIBRATION_SPEED_RPM
-    EEPROM.put( address, MOTOR_CALIBRATION_SPEED_RPM );
-    Serial.print("    Saved MOTOR_CALIBRATION_SPEED_RPM: ");
-    Serial.print(MOTOR_CALIBRATION_SPEED_RPM);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_CALIBRATION_SPEED_RPM);
-
-    // ACCEL_STEPS
-    EEPROM.put( address, ACCEL_STEPS );
-    Serial.print("    Saved ACCEL_STEPS: ");
-    Serial.print(ACCEL_STEPS);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(ACCEL_STEPS);
-
-    // MOTOR_PPR
-    EEPROM.put( address, MOTOR_PPR );
-    Serial.print("    Saved MOTOR_PPR: ");
-    Serial.print(MOTOR_PPR);
-    Serial.print(" | ");
-    Serial.println(address);
-    address += sizeof(MOTOR_PPR);
+    LOG_INFO("SaveMotorSettings");
+
+    // only the bytes that differ from the EEPROM are written
+    CONFIG_STORE_SAVE(minSpeedRpm);
+    CONFIG_STORE_SAVE(maxSpeedRpm);
+    CONFIG_STORE_SAVE(calibrationSpeedRpm);
+    CONFIG_STORE_SAVE(accelSteps);
+    CONFIG_STORE_SAVE(motorPpr);
+    CONFIG_STORE_SAVE(motorProfile);
+    CONFIG_STORE_SAVE(softLimitSteps);
+    CONFIG_STORE_SAVE(uiLanguage);
+
+    UpdateRampTable();
+}
+
+
+/*****************************************************
+ * UpdateRampTable()
+ * Rebuilds the acceleration ramp of the StepEngine from the
+ * current motor settings. Call it whenever CONFIG.maxSpeedRpm,
+ * CONFIG.accelSteps, CONFIG.motorPpr or CONFIG.motorProfile have changed.
+ */
+void UpdateRampTable()
+{
+    // a max speed slower than the start speed needs no ramp at all
+    unsigned long maxMotorPulseDelay = RPM2Delay( CONFIG.maxSpeedRpm );
+    if ( maxMotorPulseDelay > MOTOR_START_PULSE_DELAY ) { maxMotorPulseDelay = MOTOR_START_PULSE_DELAY; }
+
+    RampTableBuild( MOTOR_START_PULSE_DELAY, maxMotorPulseDelay, CONFIG.accelSteps, CONFIG.motorProfile );
+}
+
+
+/*****************************************************
+ * RemoteCanMove()
+ * returns true if the host may start and stop moves: on the main
+ * screen and the move screen, but not while the motor runs in drive
+ * mode or step mode and not in the menus or during the calibration
+ */
+bool RemoteCanMove()
+{
+    bool mainScreen = UI_STATE == UI_MAIN || UI_STATE == UI_MOVING || ( UI_STATE == UI_MESSAGE && MESSAGE_NEXT_STATE == UI_MAIN );
+    if ( !mainScreen || POSITION_HOMING_NEEDED ) { return false; }
+
+    return MotorIsMoving() || !StepEngineIsRunning();
+}
+
+
+/*****************************************************
+ * RemoteFlags()
+ * returns the SERIAL_PROTOCOL_FLAG bits of the motor and the endstops
+ */
+byte RemoteFlags()
+{
+    uint16_t inputs = ButtonScannerGetState();
+    byte flags = 0;
+
+    if ( StepEngineIsRunning() ) { flags |= SERIAL_PROTOCOL_FLAG_RUNNING; }
+    if ( inputs & (1U << INPUT_ENDSTOP_A) ) { flags |= SERIAL_PROTOCOL_FLAG_ENDSTOP_A; }
+    if ( inputs & (1U << INPUT_ENDSTOP_B) ) { flags |= SERIAL_PROTOCOL_FLAG_ENDSTOP_B; }
+    if ( StepEngineGetDirection() == HIGH ) { flags |= SERIAL_PROTOCOL_FLAG_DIRECTION; }
+
+    return flags;
+}
+
+
+/*****************************************************
+ * PositionJournalTask()
+ * Stores the position once the motor has stood still for
+ * POSITION_REST_DELAY. A position that is not known yet is never
+ * stored. The moves clear the rest marker before they start, the
+ * task only catches a move that has not done so.
+ */
+void PositionJournalTask()
+{
+    if ( !POSITION_KNOWN ) { return; }
+
+    // a single step may be over before this task sees the StepEngine running
+    unsigned long position = StepEngineGetPosition();
+    if ( StepEngineIsRunning() || MOTION_STATE != MOTION_IDLE || position != POSITION_LAST )
+    {
+        POSITION_LAST = position;
+        POSITION_MOVE_TIME = millis();
+
+        // a move that has not stored its target may have gone anywhere
+        unsigned long rest;
+        if ( PositionJournalGetRestPosition(&rest) ) { PositionJournalSetMoving( 0 ); }
+        return;
+    }
+
+    if ( millis() - POSITION_MOVE_TIME >= POSITION_REST_DELAY ) { PositionJournalSetRest(position); }
+}
+
+
+/*****************************************************
+ * MemoryReportTask()
+ * Logs the free SRAM every MEMORY_REPORT_PERIOD milliseconds,
+ * both values have to stay the same over a long session
+ */
+void MemoryReportTask()
+{
+    if ( millis() - MEMORY_REPORT_TIME < MEMORY_REPORT_PERIOD ) { return; }
+    MEMORY_REPORT_TIME = millis();
+
+    LOG_INFO("SRAM free %u bytes, lowest %u bytes", MemoryMonitorGetFree(), MemoryMonitorGetLowestFree());
+}
+
+
+/*****************************************************
+ * TelemetryTask()
+ * Queues a telemetry frame every TELEMETRY_PERIOD milliseconds
+ * once the host has switched telemetry on. It only reads the
+ * state of the StepEngine, a frame that does not fit into the
+ * send queue is skipped, the next one follows a period later.
+ */
+void TelemetryTask()
+{
+    if ( TELEMETRY_PERIOD == 0 ) { return; }
+
+    unsigned long now = millis();
+    if ( now - TELEMETRY_TIME < TELEMETRY_PERIOD ) { return; }
+
+    // keep the rate steady, but do not send the missed frames after a long loop
+    TELEMETRY_TIME += TELEMETRY_PERIOD;
+    if ( now - TELEMETRY_TIME >= TELEMETRY_PERIOD ) { TELEMETRY_TIME = now; }
+
+    byte frame[17];
+    uint16_t time = now;
+    unsigned long position = StepEngineGetPosition();
+    unsigned long interval = StepEngineGetInterval();
+
+    memcpy( frame, &time, sizeof(time) );
+    memcpy( frame + 2, &position, sizeof(position) );
+    memcpy( frame + 6, &interval, sizeof(interval) );
+    memcpy( frame + 10, &MOVE_TARGET_POSITION, sizeof(MOVE_TARGET_POSITION) );
+    frame[14] = RemoteFlags();
+    frame[15] = MOTOR_MODE;
+    frame[16] = MOTION_STATE;
+
+    SerialProtocolSend( SERIAL_PROTOCOL_NOTIFY_TELEMETRY, 0, frame, sizeof(frame) );
+}
+
+
+/*****************************************************
+ * RemoteMoveTo( unsigned long targetPosition, byte flags )
+ * Moves to a target like the position buttons do, while the motor is
+ * moving the target is queued unless SERIAL_PROTOCOL_GOTO_NOW is set
+ * returns the status for the reply
+ */
+byte RemoteMoveTo( unsigned long targetPosition, byte flags )
+{
+    if ( !RemoteCanMove() ) { return SERIAL_PROTOCOL_STATUS_BUSY; }
+
+    // without a measured track there are no limits to check the target against
+    if ( CONFIG.trackSteps == 0xFFFFFFFF ) { return SERIAL_PROTOCOL_STATUS_BUSY; }
+
+    // 0 is an empty slot, and the target has to be on the measured track
+    if ( targetPosition == 0 || targetPosition > CONFIG.trackSteps ) { return SERIAL_PROTOCOL_STATUS_BAD_VALUE; }
+
+    if ( MotorIsMoving() && !( flags & SERIAL_PROTOCOL_GOTO_NOW ) )
+    {
+        return MoveQueuePush( targetPosition ) ? SERIAL_PROTOCOL_STATUS_OK : SERIAL_PROTOCOL_STATUS_QUEUE_FULL;
+    }
+
+    MoveQueueClear();
+    MotorMoveTo( targetPosition );
+    if ( UI_STATE != UI_MOVING ) { UiEnterState(UI_MOVING); }
+
+    return SERIAL_PROTOCOL_STATUS_OK;
+}
+
+
+/*****************************************************
+ * RemoteHandleCommand( byte command, byte sequence, const byte *payload, byte length )
+ * Runs a command of the host and queues the reply,
+ * called by SerialProtocolTask() for every received frame
+ */
+void RemoteHandleCommand( byte command, byte sequence, const byte *payload, byte length )
+{
+    byte status = SERIAL_PROTOCOL_STATUS_OK;
+    byte data[29];
+    byte dataLength = 0;
+    unsigned long position = 0;
+
+    switch ( command )
+    {
+        case SERIAL_PROTOCOL_CMD_PING:
+            data[0] = SERIAL_PROTOCOL_VERSION;
+            dataLength = 1;
+            break;
+
+        case SERIAL_PROTOCOL_CMD_GOTO:
+            if ( length != 5 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            memcpy( &position, payload, sizeof(position) );
+            status = RemoteMoveTo( position, payload[4] );
+            break;
+
+        case SERIAL_PROTOCOL_CMD_GOTO_SLOT:
+            if ( length != 2 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( payload[0] >= 12 ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+            status = RemoteMoveTo( CONFIG.positions[payload[0]], payload[1] );
+            break;
+
+        case SERIAL_PROTOCOL_CMD_JOG:
+        {
+            if ( length != 4 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( MotorIsMoving() ) { status = SERIAL_PROTOCOL_STATUS_BUSY; break; }
+
+            // jogging stays inside the soft limits like drive mode, clamped
+            // in unsigned long as the positions may not fit into a long
+            long steps = 0;
+            memcpy( &steps, payload, sizeof(steps) );
+            unsigned long distance = steps < 0 ? 0UL - (unsigned long)steps : (unsigned long)steps;
+            unsigned long lower = MotorDriveLimit(HIGH);
+            unsigned long upper = MotorDriveLimit(LOW);
+
+            position = StepEngineGetPosition();
+            if ( steps < 0 )
+            {
+                // below the lower limit, or below 0 where the position would wrap around
+                position = position <= lower || position - lower <= distance ? lower : position - distance;
+            }
+            else { position = position >= upper || upper - position <= distance ? upper : position + distance; }
+
+            status = RemoteMoveTo( position, SERIAL_PROTOCOL_GOTO_NOW );
+            break;
+        }
+
+        case SERIAL_PROTOCOL_CMD_STOP:
+            if ( !RemoteCanMove() && !( UI_STATE == UI_MAIN && MOTOR_MODE == 0 ) ) { status = SERIAL_PROTOCOL_STATUS_BUSY; break; }
+
+            // drive mode brakes as soon as the encoder is back at zero
+            if ( MotorIsMoving() ) { MotorStopMove(); }
+            else { EncoderReset(); }
+            break;
+
+        case SERIAL_PROTOCOL_CMD_STATUS:
+            position = StepEngineGetPosition();
+
+            data[0] = UI_STATE;
+            data[1] = MOTION_STATE;
+            memcpy( data + 2, &position, sizeof(position) );
+            memcpy( data + 6, &MOVE_TARGET_POSITION, sizeof(MOVE_TARGET_POSITION) );
+            data[10] = MOVE_QUEUE_COUNT;
+            data[11] = RemoteFlags();
+            dataLength = 12;
+            break;
+
+        case SERIAL_PROTOCOL_CMD_MEMORY:
+        {
+            unsigned int freeBytes = MemoryMonitorGetFree();
+            unsigned int lowestFreeBytes = MemoryMonitorGetLowestFree();
+
+            memcpy( data, &freeBytes, sizeof(freeBytes) );
+            memcpy( data + 2, &lowestFreeBytes, sizeof(lowestFreeBytes) );
+            dataLength = 4;
+            break;
+        }
+
+        case SERIAL_PROTOCOL_CMD_DRIFT:
+        {
+            if ( length != 1 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( payload[0] >= CONFIG_STORE_ENDSTOPS ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            const ConfigStoreDrift &stats = CONFIG.drift[payload[0]];
+            unsigned long meanAbs = DriftMonitorGetMeanAbs( payload[0] );
+
+            data[0] = payload[0];
+            memcpy( data + 1, &stats.count, sizeof(stats.count) );
+            memcpy( data + 3, &stats.last, sizeof(stats.last) );
+            memcpy( data + 7, &stats.min, sizeof(stats.min) );
+            memcpy( data + 11, &stats.max, sizeof(stats.max) );
+            memcpy( data + 15, &meanAbs, sizeof(meanAbs) );
+            dataLength = 19;
+            break;
+        }
+
+        case SERIAL_PROTOCOL_CMD_DRIFT_RESET:
+            DriftMonitorReset();
+            break;
+
+        case SERIAL_PROTOCOL_CMD_JITTER:
+        {
+            if ( length != 1 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( payload[0] > SERIAL_PROTOCOL_JITTER_OFF ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            if ( payload[0] != SERIAL_PROTOCOL_JITTER_READ ) { StepEngineJitterEnable( payload[0] == SERIAL_PROTOCOL_JITTER_ON ); }
+
+            StepEngineJitter jitter;
+            StepEngineGetJitter( &jitter );
+            int moveMean = jitter.moveSteps > 0 ? jitter.moveSum / jitter.moveSteps : 0;
+
+            data[0] = jitter.enabled;
+            memcpy( data + 1, &jitter.steps, sizeof(jitter.steps) );
+            memcpy( data + 5, &jitter.moveSteps, sizeof(jitter.moveSteps) );
+            memcpy( data + 7, &jitter.moveMin, sizeof(jitter.moveMin) );
+            memcpy( data + 9, &jitter.moveMax, sizeof(jitter.moveMax) );
+            memcpy( data + 11, &moveMean, sizeof(moveMean) );
+            memcpy( data + 13, jitter.bins, sizeof(jitter.bins) );
+            dataLength = 29;
+            break;
+        }
+
+#if PROFILER_ENABLED
+        case SERIAL_PROTOCOL_CMD_PROFILE:
+        {
+            if ( length != 1 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( payload[0] >= PROFILER_PROBES ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            ProfilerStats stats;
+            ProfilerGet( payload[0], &stats );
+
+            data[0] = payload[0];
+            memcpy( data + 1, &stats.count, sizeof(stats.count) );
+            memcpy( data + 5, &stats.total, sizeof(stats.total) );
+            memcpy( data + 13, &stats.min, sizeof(stats.min) );
+            memcpy( data + 15, &stats.max, sizeof(stats.max) );
+            dataLength = 17;
+            break;
+        }
+
+        case SERIAL_PROTOCOL_CMD_PROFILE_RESET:
+            ProfilerReset();
+            break;
+#endif
+
+        case SERIAL_PROTOCOL_CMD_TELEMETRY:
+            if ( length != 2 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+
+            memcpy( &TELEMETRY_PERIOD, payload, sizeof(TELEMETRY_PERIOD) );
+            if ( TELEMETRY_PERIOD != 0 && TELEMETRY_PERIOD < TELEMETRY_MIN_PERIOD ) { TELEMETRY_PERIOD = TELEMETRY_MIN_PERIOD; }
+
+            // the first frame goes out right away
+            TELEMETRY_TIME = millis() - TELEMETRY_PERIOD;
+            memcpy( data, &TELEMETRY_PERIOD, sizeof(TELEMETRY_PERIOD) );
+            dataLength = 2;
+            break;
+
+        case SERIAL_PROTOCOL_CMD_GET_SETTING:
+        {
+            if ( length != 1 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( payload[0] >= MOTOR_SETTINGS_ROWS ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            unsigned int value = MotorSettingGet( payload[0] );
+            data[0] = payload[0];
+            memcpy( data + 1, &value, sizeof(value) );
+            dataLength = 3;
+            break;
+        }
+
+        case SERIAL_PROTOCOL_CMD_SET_SETTING:
+        {
+            if ( length != 3 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+
+            // the ramp table must not change under a running move
+            if ( UI_STATE != UI_MAIN || StepEngineIsRunning() ) { status = SERIAL_PROTOCOL_STATUS_BUSY; break; }
+
+            unsigned int value = 0;
+            memcpy( &value, payload + 1, sizeof(value) );
+            if ( !MotorSettingSet( payload[0], value ) ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            SaveMotorSettings();
+            break;
+        }
+
+        case SERIAL_PROTOCOL_CMD_GET_SLOT:
+            if ( length != 1 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+            if ( payload[0] >= 12 ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            data[0] = payload[0];
+            memcpy( data + 1, &CONFIG.positions[payload[0]], sizeof(CONFIG.positions[0]) );
+            dataLength = 5;
+            break;
+
+        case SERIAL_PROTOCOL_CMD_SET_SLOT:
+        {
+            if ( length != 5 ) { status = SERIAL_PROTOCOL_STATUS_BAD_LENGTH; break; }
+
+            // 0 clears the slot
+            byte slot = payload[0];
+            memcpy( &position, payload + 1, sizeof(position) );
+            if ( slot >= 12 || position > CONFIG.trackSteps ) { status = SERIAL_PROTOCOL_STATUS_BAD_VALUE; break; }
+
+            CONFIG.positions[slot] = position;
+            CONFIG_STORE_SAVE(positions[slot]);
+            break;
+        }
+
+        default:
+            status = SERIAL_PROTOCOL_STATUS_UNKNOWN;
+            break;
+    }
+
+    SerialProtocolReply( command, sequence, status, data, dataLength );
 }
 
 
 void InterruptTimerCallback()
 {
+  PROFILE(PROFILER_TIMER_ISR);
+
   // This is the Encoder's worker routine. It will physically read the hardware
   // and all most of the logic happens here. Recommended interval for this method is 1ms.
-  rotaryEncoder.service();
+  {
+    PROFILE(PROFILER_ENCODER);
+    rotaryEncoder.service();
+  }
+
+  {
+    PROFILE(PROFILER_BUTTONS);
+    ButtonScannerService();
+  }
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+// ----------------------------------------------------------------------------
+// Arduino.h stand-in for the native test environment
+// MotionMath only needs the fixed width integer types from the Arduino core.
+// ----------------------------------------------------------------------------
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef uint8_t byte;
+
+#endif // ARDUINO_H
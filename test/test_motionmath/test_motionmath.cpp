@@ -0,0 +1,390 @@
+// ----------------------------------------------------------------------------
+// MotionMath test and benchmark
+//
+// native:          pio test -e native
+//   Sweeps the integer routines over the ranges the firmware uses and compares
+//   them with a double reference. Reports the largest error of every routine
+//   and fails if it is above the rounding limit the routine promises. The host
+//   has a 32 bit int and a 64 bit long, so every sweep also checks that the
+//   intermediate products stay below 2^32 like they must on the AVR.
+//
+// megaatmega2560:  pio test -e megaatmega2560
+//   Counts the CPU cycles per call with Timer5 at prescaler 1 and compares
+//   them with the float code the routines replaced.
+// ----------------------------------------------------------------------------
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "../../src/MotionMath.cpp"
+
+#ifndef ARDUINO
+
+#include <math.h>
+
+#define TEST_AVR_ULONG_LIMIT 0x100000000ULL  // unsigned long on the AVR is 32 bits
+
+static char TEST_TEXT[96];                    // buffer of the result messages
+
+
+/*****************************************************
+ * TestReportError( const char* name, double maxError, const char* unit )
+ * prints the largest error of a routine
+ */
+void TestReportError( const char* name, double maxError, const char* unit )
+{
+    snprintf(TEST_TEXT, sizeof(TEST_TEXT), "%s max error %.4f %s", name, maxError, unit);
+    TEST_MESSAGE(TEST_TEXT);
+}
+
+
+/*****************************************************
+ * TestRPM2Delay()
+ * PPR 100 to 2000 and 1 to 1000 RPM, rounded to the nearest microsecond
+ */
+void TestRPM2Delay()
+{
+    double maxError = 0;
+    for (unsigned int ppr = 100; ppr <= 2000; ppr += 50)
+    {
+        for (unsigned int rpm = 1; rpm <= 1000; rpm++)
+        {
+            TEST_ASSERT_TRUE( (unsigned long long)rpm * ppr + MICROSECONDS_PER_MINUTE < TEST_AVR_ULONG_LIMIT );
+
+            double reference = 60000000.0 / ((double)rpm * ppr);
+            double error = fabs((double)MotionMathRPM2Delay(rpm, ppr) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathRPM2Delay", maxError, "us");
+    TEST_ASSERT_TRUE( maxError <= 0.5 );
+}
+
+
+/*****************************************************
+ * TestDelay2RPM()
+ * PPR 100 to 2000 and the pulse delays of 1 to 1000 RPM
+ */
+void TestDelay2RPM()
+{
+    double maxError = 0;
+    for (unsigned int ppr = 100; ppr <= 2000; ppr += 50)
+    {
+        for (unsigned long pulseDelay = 30; pulseDelay <= 600000UL / ppr * 100; pulseDelay += 1 + pulseDelay / 256)
+        {
+            TEST_ASSERT_TRUE( (unsigned long long)pulseDelay * ppr + MICROSECONDS_PER_MINUTE < TEST_AVR_ULONG_LIMIT );
+
+            double reference = 60000000.0 / ((double)pulseDelay * ppr);
+            if ( reference > 65535.0 ) { continue; }
+
+            double error = fabs((double)MotionMathDelay2RPM(pulseDelay, ppr) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathDelay2RPM", maxError, "RPM");
+    TEST_ASSERT_TRUE( maxError <= 0.5 );
+}
+
+
+/*****************************************************
+ * TestLinearMap()
+ * the poti range 0 to 1023 onto rising and falling speed ranges
+ */
+void TestLinearMap()
+{
+    const long ranges[][2] = { {1, 1000}, {1000, 1}, {-500, 500}, {0, 100000}, {100000, 0} };
+
+    double maxError = 0;
+    for (unsigned int r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++)
+    {
+        long bMin = ranges[r][0];
+        long bMax = ranges[r][1];
+        for (long ax = -10; ax <= 1033; ax++)
+        {
+            TEST_ASSERT_TRUE( 1023LL * llabs(bMax - bMin) < TEST_AVR_ULONG_LIMIT / 2 );
+
+            double clamped = ax < 0 ? 0 : (ax > 1023 ? 1023 : ax);
+            double reference = bMin + clamped * (bMax - bMin) / 1023.0;
+            double error = fabs((double)MotionMathLinearMap(ax, 0, 1023, bMin, bMax) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathLinearMap", maxError, "");
+    TEST_ASSERT_TRUE( maxError <= 0.5 );
+}
+
+
+/*****************************************************
+ * TestPercent()
+ * 0 to 100 percent of values up to 2^32 - 1
+ */
+void TestPercent()
+{
+    double maxError = 0;
+    for (unsigned long long value = 0; value < TEST_AVR_ULONG_LIMIT; value = value * 3 / 2 + 7)
+    {
+        for (unsigned int percent = 0; percent <= 100; percent++)
+        {
+            double reference = (double)value * percent / 100.0;
+            double error = fabs((double)MotionMathPercent((unsigned long)value, percent) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathPercent", maxError, "");
+    TEST_ASSERT_TRUE( maxError <= 0.5 );
+}
+
+
+/*****************************************************
+ * TestRatio16()
+ * ramp table index scale, truncated to the 16.16 fixed point step
+ */
+void TestRatio16()
+{
+    double maxError = 0;
+    for (unsigned long denominator = 1; denominator <= 65535; denominator += 1 + denominator / 64)
+    {
+        for (unsigned long numerator = 0; numerator <= 65535 && numerator < denominator * 65536; numerator += 1 + numerator / 16)
+        {
+            double reference = (double)numerator / denominator;
+            double value = (double)MotionMathRatio16(numerator, denominator) / FIXED16_ONE;
+            double error = fabs(value - reference) * FIXED16_ONE;
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathRatio16", maxError, "LSB");
+    TEST_ASSERT_TRUE( maxError < 1.0 );
+}
+
+
+/*****************************************************
+ * TestLerp16()
+ * all fractions between rising and falling pulse delays
+ */
+void TestLerp16()
+{
+    const unsigned int ends[][2] = { {0, 65535}, {65535, 0}, {30, 50000}, {50000, 30}, {1000, 1001} };
+
+    double maxError = 0;
+    for (unsigned int e = 0; e < sizeof(ends) / sizeof(ends[0]); e++)
+    {
+        unsigned int from = ends[e][0];
+        unsigned int to = ends[e][1];
+        for (unsigned long fraction = 0; fraction <= 0xFFFF; fraction++)
+        {
+            double reference = from + ((double)to - from) * fraction / 65536.0;
+            double error = fabs((double)MotionMathLerp16(from, to, fraction) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathLerp16", maxError, "");
+    TEST_ASSERT_TRUE( maxError <= 0.5 );
+}
+
+
+/*****************************************************
+ * TestFraction16()
+ * steps left of a move up to 2^31 - 1 steps, truncated to 1/65536
+ */
+void TestFraction16()
+{
+    double maxError = 0;
+    for (unsigned long long denominator = 1; denominator < TEST_AVR_ULONG_LIMIT / 2; denominator = denominator * 5 / 4 + 1)
+    {
+        for (unsigned long long numerator = 0; numerator < denominator; numerator += 1 + denominator / 997)
+        {
+            double reference = (double)numerator / denominator * 65536.0;
+            double error = fabs((double)MotionMathFraction16(numerator, denominator) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathFraction16", maxError, "LSB");
+    TEST_ASSERT_TRUE( maxError < 1.0 );
+}
+
+
+/*****************************************************
+ * TestSCurve16()
+ * the jerk limited curve over all 65536 fractions
+ */
+void TestSCurve16()
+{
+    double maxError = 0;
+    unsigned int last = 0;
+    for (unsigned long fraction = 0; fraction <= 0xFFFF; fraction++)
+    {
+        double u = fraction / 65535.0;
+        double reference;
+        if ( u < 1.0 / 3 )      { reference = 2.25 * u * u; }
+        else if ( u < 2.0 / 3 ) { reference = 0.25 + 1.5 * (u - 1.0 / 3); }
+        else                    { reference = 1.0 - 2.25 * (1.0 - u) * (1.0 - u); }
+
+        unsigned int value = MotionMathSCurve16(fraction);
+        double error = fabs((double)value - reference * 65535.0);
+        if ( error > maxError ) { maxError = error; }
+
+        // the ramp must never slow down on the way up
+        TEST_ASSERT_TRUE( value >= last );
+        last = value;
+    }
+
+    TestReportError("MotionMathSCurve16", maxError, "LSB");
+    TEST_ASSERT_TRUE( maxError <= 4.0 );
+}
+
+
+/*****************************************************
+ * TestTravelTime()
+ * up to 2^32 - 1 steps at pulse delays of 30 to 60000 microseconds
+ */
+void TestTravelTime()
+{
+    double maxError = 0;
+    for (unsigned long pulseDelay = 30; pulseDelay <= 60000; pulseDelay += 1 + pulseDelay / 32)
+    {
+        for (unsigned long long steps = 0; steps < TEST_AVR_ULONG_LIMIT; steps = steps * 3 / 2 + 11)
+        {
+            double reference = (double)steps * pulseDelay / 1000.0;
+            if ( reference >= (double)(TEST_AVR_ULONG_LIMIT - 1) ) { break; }
+
+            TEST_ASSERT_TRUE( 999ULL * pulseDelay + 500 < TEST_AVR_ULONG_LIMIT );
+
+            double error = fabs((double)MotionMathTravelTime(steps, pulseDelay) - reference);
+            if ( error > maxError ) { maxError = error; }
+        }
+    }
+
+    TestReportError("MotionMathTravelTime", maxError, "ms");
+    TEST_ASSERT_TRUE( maxError <= 0.5 );
+}
+
+
+int main( int argc, char** argv )
+{
+    UNITY_BEGIN();
+    RUN_TEST(TestRPM2Delay);
+    RUN_TEST(TestDelay2RPM);
+    RUN_TEST(TestLinearMap);
+    RUN_TEST(TestPercent);
+    RUN_TEST(TestRatio16);
+    RUN_TEST(TestLerp16);
+    RUN_TEST(TestFraction16);
+    RUN_TEST(TestSCurve16);
+    RUN_TEST(TestTravelTime);
+    return UNITY_END();
+}
+
+#else // ARDUINO
+
+#define BENCH_CALLS 64                  // calls per routine, the inputs change with every call
+
+volatile unsigned long BENCH_IN_A;      // inputs the compiler can not fold away
+volatile unsigned long BENCH_IN_B;
+volatile unsigned long BENCH_OUT;       // result sink
+static char BENCH_TEXT[64];             // buffer of the result messages
+
+typedef void (*BenchCall)( uint8_t i );
+
+
+/*****************************************************
+ * BenchCycles( BenchCall call )
+ * returns the average CPU cycles of call over BENCH_CALLS inputs
+ * including the call overhead of the bench itself
+ */
+unsigned int BenchCycles( BenchCall call )
+{
+    unsigned long total = 0;
+
+    TCCR5A = 0;
+    TCCR5C = 0;
+    TCCR5B = _BV(CS50);
+
+    for (uint8_t i = 0; i < BENCH_CALLS; i++)
+    {
+        noInterrupts();
+        uint16_t start = TCNT5;
+        call(i);
+        uint16_t end = TCNT5;
+        interrupts();
+        total += (uint16_t)(end - start);
+    }
+
+    TCCR5B = 0;
+    return total / BENCH_CALLS;
+}
+
+
+void BenchEmpty( uint8_t i )        { BENCH_OUT = BENCH_IN_A + i; }
+void BenchRPM2Delay( uint8_t i )    { BENCH_OUT = MotionMathRPM2Delay( BENCH_IN_A + i * 13, BENCH_IN_B ); }
+void BenchDelay2RPM( uint8_t i )    { BENCH_OUT = MotionMathDelay2RPM( BENCH_IN_A + i * 97, BENCH_IN_B ); }
+void BenchLinearMap( uint8_t i )    { BENCH_OUT = MotionMathLinearMap( i * 16, 0, 1023, 1, BENCH_IN_A ); }
+void BenchPercent( uint8_t i )      { BENCH_OUT = MotionMathPercent( BENCH_IN_A * i, i ); }
+void BenchRatio16( uint8_t i )      { BENCH_OUT = MotionMathRatio16( BENCH_IN_B, BENCH_IN_A + i ); }
+void BenchLerp16( uint8_t i )       { BENCH_OUT = MotionMathLerp16( BENCH_IN_A, BENCH_IN_B, i * 1021 ); }
+void BenchFraction16( uint8_t i )   { BENCH_OUT = MotionMathFraction16( BENCH_IN_A * i, BENCH_IN_A * 64 ); }
+void BenchSCurve16( uint8_t i )     { BENCH_OUT = MotionMathSCurve16( i * 1021 ); }
+void BenchTravelTime( uint8_t i )   { BENCH_OUT = MotionMathTravelTime( BENCH_IN_A * i, BENCH_IN_B ); }
+
+// the float code the integer routines replaced
+void BenchFloatRPM2Delay( uint8_t i )   { BENCH_OUT = 60000000.0 / ((float)(BENCH_IN_A + i * 13) * BENCH_IN_B); }
+void BenchFloatLinearMap( uint8_t i )   { BENCH_OUT = 1 + (1.0 * (BENCH_IN_A - 1) / 1023) * (i * 16); }
+
+
+/*****************************************************
+ * BenchReport( const char* name, BenchCall call )
+ * prints the cycles per call of a routine without the bench overhead
+ */
+void BenchReport( const char* name, BenchCall call )
+{
+    unsigned int overhead = BenchCycles(BenchEmpty);
+    unsigned int cycles = BenchCycles(call);
+
+    snprintf(BENCH_TEXT, sizeof(BENCH_TEXT), "%s %u cycles", name, cycles > overhead ? cycles - overhead : 0);
+    TEST_MESSAGE(BENCH_TEXT);
+}
+
+
+void TestBenchmark()
+{
+    BENCH_IN_A = 200;
+    BENCH_IN_B = 400;
+
+    BenchReport("MotionMathRPM2Delay", BenchRPM2Delay);
+    BenchReport("float RPM2Delay", BenchFloatRPM2Delay);
+    BenchReport("MotionMathLinearMap", BenchLinearMap);
+    BenchReport("float LinearMap", BenchFloatLinearMap);
+    BenchReport("MotionMathPercent", BenchPercent);
+    BenchReport("MotionMathRatio16", BenchRatio16);
+    BenchReport("MotionMathLerp16", BenchLerp16);
+    BenchReport("MotionMathSCurve16", BenchSCurve16);
+    BenchReport("MotionMathTravelTime", BenchTravelTime);
+
+    BENCH_IN_A = 3000;
+    BenchReport("MotionMathDelay2RPM", BenchDelay2RPM);
+    BenchReport("MotionMathFraction16", BenchFraction16);
+}
+
+
+void setup()
+{
+    // give the board time to open the serial port after the reset
+    delay(2000);
+
+    UNITY_BEGIN();
+    RUN_TEST(TestBenchmark);
+    UNITY_END();
+}
+
+
+void loop()
+{
+}
+
+#endif // ARDUINO
@@ -0,0 +1,435 @@
+#!/usr/bin/env python3
+"""Host side of the LokLift serial protocol (see include/SerialProtocol.h).
+
+Talk to the controller:
+
+    loklift_serial.py /dev/ttyACM0 status
+    loklift_serial.py /dev/ttyACM0 goto 12000 --now
+    loklift_serial.py /dev/ttyACM0 slot 3 --wait
+
+Run a stand-in of the controller on a pseudo terminal, so layout software
+can be tested on a Linux host without the lift:
+
+    loklift_serial.py --simulate
+    loklift_serial.py /dev/pts/5 goto 12000 --wait
+
+Needs pyserial (pip install pyserial) to open a port, the stand-in only
+needs the standard library.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import tty
+
+START = 0xA5
+MAX_PAYLOAD = 32
+BAUD = 115200
+
+CMD_PING = 0x01
+CMD_GOTO = 0x10
+CMD_GOTO_SLOT = 0x11
+CMD_JOG = 0x12
+CMD_STOP = 0x13
+CMD_STATUS = 0x20
+CMD_TELEMETRY = 0x21
+CMD_MEMORY = 0x22
+CMD_DRIFT = 0x23
+CMD_DRIFT_RESET = 0x24
+CMD_JITTER = 0x25
+CMD_PROFILE = 0x26
+CMD_PROFILE_RESET = 0x27
+CMD_GET_SETTING = 0x30
+CMD_SET_SETTING = 0x31
+CMD_GET_SLOT = 0x32
+CMD_SET_SLOT = 0x33
+REPLY = 0x80
+NOTIFY_MOVE_DONE = 0xC0
+NOTIFY_TELEMETRY = 0xC1
+GOTO_NOW = 0x01
+
+STATUS = ["OK", "BAD_CRC", "BAD_LENGTH", "BAD_VALUE", "BUSY", "UNKNOWN", "QUEUE_FULL"]
+MOVE_REASONS = ["reached", "stopped", "endstop"]
+SETTINGS = ["MaxRPM", "MinRPM", "CalRPM", "AccStp", "MotPPR", "Profil", "Limit", "Sprache"]
+PROBES = ["loop", "InputTask", "SerialProtocolTask", "MotionTask", "CheckEndStop", "UiTask", "DrawText",
+          "DisplayTask", "EepromWriterTask", "timer ISR", "encoder", "buttons", "step ISR", "ramp"]
+UI_STATES = ["BOOT", "HOMING", "MAIN", "MOVING", "SAVE_POSITION", "SETTINGS", "CALIBRATING", "MESSAGE"]
+MOTION_STATES = ["IDLE", "HOMING_FAST", "HOMING", "HOMING_RELEASE", "HOMING_CREEP", "HOMING_BACK_OFF",
+                 "MOVING", "REVERSING", "CALIBRATE_TO_B", "CALIBRATE_TO_A", "CALIBRATE_BACK_OFF"]
+
+
+def crc8(data):
+    """CRC-8 with polynomial 0x07 and start value 0 like _crc8_ccitt_update()"""
+    crc = 0
+    for value in data:
+        crc ^= value
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def encode(command, sequence, payload=b""):
+    body = bytes([len(payload), command, sequence]) + payload
+    return bytes([START]) + body + bytes([crc8(body)])
+
+
+class Parser:
+    """Splits the received bytes into frames and log text"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data):
+        """returns a list of ("frame", command, sequence, payload) and ("text", line) items"""
+        self.buffer += data
+        items = []
+        while self.buffer:
+            if self.buffer[0] != START:
+                end = self.buffer.find(b"\n")
+                start = self.buffer.find(bytes([START]))
+                if end < 0 and start < 0:
+                    break
+                if start < 0 or (0 <= end < start):
+                    items.append(("text", self.buffer[:end].decode("ascii", "replace").strip()))
+                    del self.buffer[:end + 1]
+                else:
+                    del self.buffer[:start]
+                continue
+            if len(self.buffer) < 2:
+                break
+            length = self.buffer[1]
+            if length > MAX_PAYLOAD:
+                del self.buffer[:1]
+                continue
+            if len(self.buffer) < length + 5:
+                break
+            frame = bytes(self.buffer[:length + 5])
+            if crc8(frame[1:-1]) != frame[-1]:
+                del self.buffer[:1]
+                continue
+            items.append(("frame", frame[2], frame[3], frame[4:-1]))
+            del self.buffer[:length + 5]
+        return items
+
+
+class Client:
+    def __init__(self, port):
+        import serial
+        self.port = serial.Serial(port, BAUD, timeout=0.05)
+        self.parser = Parser()
+        self.sequence = 0
+
+    def events(self, timeout):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            for item in self.parser.feed(self.port.read(256)):
+                yield item
+
+    def request(self, command, payload=b"", timeout=1.0):
+        self.sequence = self.sequence % 255 + 1
+        self.port.write(encode(command, self.sequence, payload))
+        for item in self.events(timeout):
+            if item[0] == "text":
+                print("log:", item[1], file=sys.stderr)
+            elif item[1] == command | REPLY and item[2] == self.sequence:
+                status = item[3][0]
+                if status != 0:
+                    raise RuntimeError(STATUS[status] if status < len(STATUS) else status)
+                return item[3][1:]
+            else:
+                report(item)
+        raise TimeoutError("no reply")
+
+    def wait_move_done(self, timeout):
+        for item in self.events(timeout):
+            if item[0] == "frame" and item[1] == NOTIFY_MOVE_DONE:
+                return report(item)
+            if item[0] == "text":
+                print("log:", item[1], file=sys.stderr)
+        raise TimeoutError("move not done")
+
+
+def report(item):
+    if item[0] == "frame" and item[1] == NOTIFY_MOVE_DONE:
+        reason, position = struct.unpack("<BI", item[3])
+        print("move done: %s at %d" % (MOVE_REASONS[reason], position))
+        return position
+    if item[0] == "frame" and item[1] == NOTIFY_TELEMETRY:
+        time_ms, position, interval, target, flags, mode, motion = struct.unpack("<HIIIBBB", item[3])
+        print("%5d ms  position %d  delay %d us  target %d  %s%s  mode %d  %s" % (
+            time_ms, position, interval, target, "running " if flags & 1 else "", "towards A" if flags & 8 else "towards B",
+            mode, MOTION_STATES[motion]))
+        return position
+    print("frame:", item[1:])
+
+
+class StandIn:
+    """A controller on a pseudo terminal: answers every command and moves
+    a simulated lift with a constant speed"""
+
+    SPEED = 4000  # steps per second
+
+    def __init__(self, track_steps):
+        self.master, slave = os.openpty()
+        tty.setraw(slave)
+        self.name = os.ttyname(slave)
+        os.set_blocking(self.master, False)
+        self.parser = Parser()
+        self.track = track_steps
+        self.position = track_steps // 10
+        self.target = self.position
+        self.queue = []
+        self.moving = False
+        self.reason = 0
+        self.settings = [420, 25, 300, 400, 200, 0, 200, 0]
+        self.slots = [0] * 12
+        self.telemetry = 0
+        self.telemetry_time = 0
+
+    def send(self, command, sequence, payload=b""):
+        os.write(self.master, encode(command, sequence, payload))
+
+    def start(self, target, now):
+        if self.track == 0xFFFFFFFF:
+            return 4
+        if target == 0 or target > self.track:
+            return 3
+        if self.moving and not now:
+            if len(self.queue) >= 8:
+                return 6
+            self.queue.append(target)
+            return 0
+        self.queue = []
+        self.target = target
+        self.moving = True
+        self.reason = 0
+        return 0
+
+    def handle(self, command, sequence, payload):
+        status, data = 0, b""
+        try:
+            if command == CMD_PING:
+                data = bytes([1])
+            elif command == CMD_GOTO:
+                target, flags = struct.unpack("<IB", payload)
+                status = self.start(target, flags & GOTO_NOW)
+            elif command == CMD_GOTO_SLOT:
+                slot, flags = struct.unpack("<BB", payload)
+                status = self.start(self.slots[slot], flags & GOTO_NOW) if slot < 12 else 3
+            elif command == CMD_JOG:
+                (steps,) = struct.unpack("<i", payload)
+                limit = self.settings[6]
+                status = 4 if self.moving else self.start(max(limit, min(self.track - limit, self.position + steps)), True)
+            elif command == CMD_STOP:
+                self.queue = []
+                self.target = self.position
+                self.reason = 1
+            elif command == CMD_STATUS:
+                data = struct.pack("<BBIIBB", 3 if self.moving else 2, 3 if self.moving else 0,
+                                   self.position, self.target, len(self.queue), 1 if self.moving else 0)
+            elif command == CMD_TELEMETRY:
+                (period,) = struct.unpack("<H", payload)
+                self.telemetry = max(period, 10) if period else 0
+                data = struct.pack("<H", self.telemetry)
+            elif command == CMD_MEMORY:
+                data = struct.pack("<HH", 2048, 1900)
+            elif command == CMD_DRIFT:
+                (endstop,) = struct.unpack("<B", payload)
+                data = struct.pack("<BHiiiI", endstop, 0, 0, 0, 0, 0) if endstop < 2 else b""
+                status = 0 if data else 3
+            elif command == CMD_DRIFT_RESET:
+                pass
+            elif command == CMD_JITTER:
+                (action,) = struct.unpack("<B", payload)
+                data = struct.pack("<BIHhhh8H", action == 1, 0, 0, 0, 0, 0, *[0] * 8) if action <= 2 else b""
+                status = 0 if data else 3
+            elif command == CMD_GET_SETTING:
+                (row,) = struct.unpack("<B", payload)
+                data = struct.pack("<BH", row, self.settings[row]) if row < len(self.settings) else b""
+                status = 0 if data else 3
+            elif command == CMD_SET_SETTING:
+                row, value = struct.unpack("<BH", payload)
+                if row < len(self.settings):
+                    self.settings[row] = value
+                else:
+                    status = 3
+            elif command == CMD_GET_SLOT:
+                (slot,) = struct.unpack("<B", payload)
+                data = struct.pack("<BI", slot, self.slots[slot]) if slot < 12 else b""
+                status = 0 if data else 3
+            elif command == CMD_SET_SLOT:
+                slot, position = struct.unpack("<BI", payload)
+                if slot < 12 and position <= self.track:
+                    self.slots[slot] = position
+                else:
+                    status = 3
+            else:
+                status = 5
+        except struct.error:
+            status, data = 2, b""
+        self.send(command | REPLY, sequence, bytes([status]) + data)
+
+    def send_telemetry(self):
+        now = int(time.monotonic() * 1000)
+        if not self.telemetry or now - self.telemetry_time < self.telemetry:
+            return
+        self.telemetry_time = now
+        interval = 1000000 // self.SPEED if self.moving else 0
+        flags = (1 if self.moving else 0) | (8 if self.target < self.position else 0)
+        self.send(NOTIFY_TELEMETRY, 0, struct.pack("<HIIIBBB", now & 0xFFFF, self.position, interval, self.target,
+                                                   flags, 0, 3 if self.moving else 0))
+
+    def step(self, seconds):
+        if not self.moving:
+            return
+        distance = int(self.SPEED * seconds) or 1
+        if abs(self.target - self.position) <= distance:
+            self.position = self.target
+            if self.queue:
+                self.target = self.queue.pop(0)
+            else:
+                self.moving = False
+                self.send(NOTIFY_MOVE_DONE, 0, struct.pack("<BI", self.reason, self.position))
+        else:
+            self.position += distance if self.target > self.position else -distance
+
+    def run(self):
+        print("stand-in listens on", self.name, flush=True)
+        os.write(self.master, b"I stand-in ready\r\n")
+        last = time.monotonic()
+        while True:
+            try:
+                data = os.read(self.master, 256)
+            except BlockingIOError:
+                data = b""
+            for item in self.parser.feed(data):
+                if item[0] == "frame":
+                    self.handle(*item[1:])
+            now = time.monotonic()
+            self.step(now - last)
+            self.send_telemetry()
+            last = now
+            time.sleep(0.005)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?", help="serial port of the controller")
+    parser.add_argument("--simulate", action="store_true", help="run a stand-in of the controller on a pseudo terminal")
+    parser.add_argument("--track", type=int, default=50000, help="track steps of the stand-in")
+    commands = parser.add_subparsers(dest="command")
+    commands.add_parser("ping")
+    commands.add_parser("status")
+    commands.add_parser("stop")
+    commands.add_parser("memory", help="free SRAM now and lowest since reset")
+    command = commands.add_parser("drift", help="how far from the counted position the endstops trip")
+    command.add_argument("--reset", action="store_true", help="clear the statistics afterwards")
+    command = commands.add_parser("profile", help="time spent in the probes, needs PROFILER_ENABLED 1")
+    command.add_argument("--reset", action="store_true", help="clear the statistics afterwards")
+    command = commands.add_parser("jitter", help="deviation of the real step intervals from the loaded ones")
+    command.add_argument("action", nargs="?", choices=["show", "on", "off"], default="show",
+                         help="on clears the measurement and switches it on")
+    commands.add_parser("monitor", help="print log text and notifications")
+    command = commands.add_parser("telemetry", help="switch telemetry on and print it")
+    command.add_argument("rate", type=int, nargs="?", default=50, help="frames per second, 0 switches it off")
+    for name in ("goto", "slot"):
+        command = commands.add_parser(name)
+        command.add_argument("value", type=int)
+        command.add_argument("--now", action="store_true", help="drop the queue and head there right away")
+        command.add_argument("--wait", action="store_true", help="wait for the end of the move")
+    command = commands.add_parser("jog")
+    command.add_argument("steps", type=int)
+    command.add_argument("--wait", action="store_true")
+    command = commands.add_parser("get-setting")
+    command.add_argument("row", type=int, help=", ".join("%d %s" % item for item in enumerate(SETTINGS)))
+    command = commands.add_parser("set-setting")
+    command.add_argument("row", type=int)
+    command.add_argument("value", type=int)
+    command = commands.add_parser("get-slot")
+    command.add_argument("slot", type=int, help="1 to 12 like the buttons")
+    command = commands.add_parser("set-slot")
+    command.add_argument("slot", type=int)
+    command.add_argument("position", type=int)
+    args = parser.parse_args()
+
+    if args.simulate:
+        StandIn(args.track).run()
+        return
+    if not args.port or not args.command:
+        parser.error("port and command are required")
+
+    client = Client(args.port)
+    if args.command == "ping":
+        print("protocol version", client.request(CMD_PING)[0])
+    elif args.command == "status":
+        ui, motion, position, target, queued, flags = struct.unpack("<BBIIBB", client.request(CMD_STATUS))
+        print("ui %s, motion %s, position %d, target %d, queued %d, running %d, endstop A %d, endstop B %d" % (
+            UI_STATES[ui], MOTION_STATES[motion], position, target, queued, flags & 1, flags >> 1 & 1, flags >> 2 & 1))
+    elif args.command == "stop":
+        client.request(CMD_STOP)
+    elif args.command == "memory":
+        free, lowest = struct.unpack("<HH", client.request(CMD_MEMORY))
+        print("SRAM free %d bytes, lowest %d bytes" % (free, lowest))
+    elif args.command == "drift":
+        for endstop in (0, 1):
+            _, count, last, low, high, mean = struct.unpack("<BHiiiI", client.request(CMD_DRIFT, bytes([endstop])))
+            print("endstop %s: %d trips, last %d, min %d, max %d, mean absolute %d steps" % (
+                "AB"[endstop], count, last, low, high, mean))
+        if args.reset:
+            client.request(CMD_DRIFT_RESET)
+    elif args.command == "profile":
+        try:
+            print("%-20s %10s %12s %10s %10s %10s" % ("probe", "count", "total ms", "mean us", "min us", "max us"))
+            for probe, name in enumerate(PROBES):
+                _, count, total, low, high = struct.unpack("<BIQHH", client.request(CMD_PROFILE, bytes([probe])))
+                mean = total / count / 2 if count else 0
+                print("%-20s %10d %12.1f %10.1f %10.1f %10.1f" % (name, count, total / 2000, mean, low / 2, high / 2))
+            if args.reset:
+                client.request(CMD_PROFILE_RESET)
+        except RuntimeError as error:
+            sys.exit("profile: %s, is the firmware built with PROFILER_ENABLED 1?" % error)
+    elif args.command == "jitter":
+        reply = client.request(CMD_JITTER, bytes([["show", "on", "off"].index(args.action)]))
+        enabled, steps, move_steps, low, high, mean, *bins = struct.unpack("<BIHhhh8H", reply)
+        print("measurement %s, %d steps" % ("on" if enabled else "off", steps))
+        print("last move: %d steps, min %.1f us, max %.1f us, mean %.1f us" % (move_steps, low / 2, high / 2, mean / 2))
+        for bin, count in enumerate(bins):
+            limit = "< %d us" % (1 << bin) if bin < len(bins) - 1 else ">= %d us" % (1 << (bin - 1))
+            print("%9s %6d %s" % (limit, count, "#" * min(60, count * 60 // max(1, max(bins)))))
+    elif args.command == "telemetry":
+        period = 1000 // args.rate if args.rate > 0 else 0
+        (period,) = struct.unpack("<H", client.request(CMD_TELEMETRY, struct.pack("<H", period)))
+        if period:
+            try:
+                for item in client.events(float("inf")):
+                    print("log:", item[1]) if item[0] == "text" else report(item)
+            finally:
+                client.request(CMD_TELEMETRY, struct.pack("<H", 0))
+    elif args.command == "monitor":
+        for item in client.events(float("inf")):
+            print("log:", item[1]) if item[0] == "text" else report(item)
+    elif args.command in ("goto", "slot", "jog"):
+        if args.command == "goto":
+            client.request(CMD_GOTO, struct.pack("<IB", args.value, GOTO_NOW if args.now else 0))
+        elif args.command == "slot":
+            client.request(CMD_GOTO_SLOT, struct.pack("<BB", args.value - 1, GOTO_NOW if args.now else 0))
+        else:
+            client.request(CMD_JOG, struct.pack("<i", args.steps))
+        if args.wait:
+            client.wait_move_done(120)
+    elif args.command == "get-setting":
+        row, value = struct.unpack("<BH", client.request(CMD_GET_SETTING, bytes([args.row])))
+        print(SETTINGS[row], value)
+    elif args.command == "set-setting":
+        client.request(CMD_SET_SETTING, struct.pack("<BH", args.row, args.value))
+    elif args.command == "get-slot":
+        slot, position = struct.unpack("<BI", client.request(CMD_GET_SLOT, bytes([args.slot - 1])))
+        print("slot", slot + 1, position)
+    elif args.command == "set-slot":
+        client.request(CMD_SET_SLOT, struct.pack("<BI", args.slot - 1, args.position))
+
+
+if __name__ == "__main__":
+    main()